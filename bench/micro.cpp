@@ -0,0 +1,225 @@
+#include "bbinit.h"
+#include "board.h"
+#include "eval.h"
+#include "uci.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <vector>
+#include <x86intrin.h>
+
+// Microbenchmarks of the board primitives. Each benchmark runs over a corpus
+// of positions taken from random games, so branch predictors and caches see
+// a realistic mix instead of one position over and over.
+
+const int CORPUS_SIZE = 1024;
+const int SAMPLES = 15;
+const int WARMUP_SAMPLES = 3;
+// Each sample repeats the corpus until it takes at least this long
+const double MIN_SAMPLE_NS = 20e6;
+
+static const char *SEED_POSITIONS[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 11"
+};
+
+static std::vector<Board> corpus;
+// Accumulates every result so the compiler cannot drop the work
+static volatile uint64_t sink;
+
+static void buildCorpus() {
+    std::mt19937 rng(12345);
+    const int seeds = sizeof(SEED_POSITIONS) / sizeof(SEED_POSITIONS[0]);
+    while ((int) corpus.size() < CORPUS_SIZE) {
+        Board b = fenToBoard(SEED_POSITIONS[corpus.size() % seeds]);
+        int plies = rng() % 60;
+        ScoredMove buffer[MAX_MOVES];
+        ScoredMoveList moves(buffer);
+        for (int i = 0; i < plies; i++) {
+            b.getAllLegalMove(moves, b.getPlayerToMove());
+            if (moves.size() == 0)
+                break;
+            b.doMove(moves.get(rng() % moves.size()), b.getPlayerToMove());
+        }
+        if (b.hasLegalMove(b.getPlayerToMove()))
+            corpus.push_back(b.staticCopy());
+    }
+}
+
+// fn makes one pass over the corpus and returns the number of operations done
+static void runBenchmark(const char *name, const std::function<uint64_t()> &fn) {
+    uint64_t ops = fn();
+    int repeats = 1;
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    double once = std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now() - start).count();
+    if (once < MIN_SAMPLE_NS)
+        repeats = (int) (MIN_SAMPLE_NS / std::max(once, 1.0)) + 1;
+
+    std::vector<double> ns, cycles;
+    for (int s = 0; s < WARMUP_SAMPLES + SAMPLES; s++) {
+        auto startTime = std::chrono::steady_clock::now();
+        uint64_t startTsc = __rdtsc();
+        for (int r = 0; r < repeats; r++)
+            fn();
+        uint64_t tsc = __rdtsc() - startTsc;
+        double elapsed = std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - startTime).count();
+        if (s < WARMUP_SAMPLES)
+            continue;
+        ns.push_back(elapsed / ((double) ops * repeats));
+        cycles.push_back((double) tsc / ((double) ops * repeats));
+    }
+
+    double mean = 0, variance = 0, meanCycles = 0;
+    for (int s = 0; s < SAMPLES; s++) {
+        mean += ns[s] / SAMPLES;
+        meanCycles += cycles[s] / SAMPLES;
+    }
+    for (int s = 0; s < SAMPLES; s++)
+        variance += (ns[s] - mean) * (ns[s] - mean) / (SAMPLES - 1);
+    double best = *std::min_element(ns.begin(), ns.end());
+
+    std::printf("%-24s %10.2f ns/op  +/- %5.1f%%  min %10.2f ns/op  %10.1f cycles/op\n",
+        name, mean, 100.0 * std::sqrt(variance) / mean, best, meanCycles);
+}
+
+int main() {
+    initZobristTable();
+    initMagicTables();
+    initInBetweenTable();
+    initEvalTables();
+    buildCorpus();
+
+    std::printf("%d positions, %d samples after %d warmup samples, cycles are TSC ticks\n\n",
+        CORPUS_SIZE, SAMPLES, WARMUP_SAMPLES);
+
+    runBenchmark("getRookAttacks", []() {
+        uint64_t acc = 0;
+        for (Board &b : corpus) {
+            uint64_t occ = b.getOccupancy();
+            for (int sq = 0; sq < 64; sq++)
+                acc ^= b.getRookAttacks(sq, occ);
+        }
+        sink += acc;
+        return (uint64_t) corpus.size() * 64;
+    });
+
+    runBenchmark("getBishopAttacks", []() {
+        uint64_t acc = 0;
+        for (Board &b : corpus) {
+            uint64_t occ = b.getOccupancy();
+            for (int sq = 0; sq < 64; sq++)
+                acc ^= b.getBishopAttacks(sq, occ);
+        }
+        sink += acc;
+        return (uint64_t) corpus.size() * 64;
+    });
+
+    runBenchmark("isSquareAttacked", []() {
+        uint64_t acc = 0;
+        for (Board &b : corpus) {
+            for (int sq = 0; sq < 64; sq++)
+                acc += b.isSquareAttacked(sq, 1 - b.getPlayerToMove());
+        }
+        sink += acc;
+        return (uint64_t) corpus.size() * 64;
+    });
+
+    runBenchmark("getAttackedSquares", []() {
+        uint64_t acc = 0;
+        for (Board &b : corpus)
+            acc ^= b.getAttackedSquares(1 - b.getPlayerToMove(), b.getOccupancy());
+        sink += acc;
+        return (uint64_t) corpus.size();
+    });
+
+    runBenchmark("hasLegalMove", []() {
+        uint64_t acc = 0;
+        for (Board &b : corpus)
+            acc += b.hasLegalMove(b.getPlayerToMove());
+        sink += acc;
+        return (uint64_t) corpus.size();
+    });
+
+    runBenchmark("getAllPseudoLegalMoves", []() {
+        uint64_t acc = 0;
+        ScoredMove buffer[MAX_MOVES];
+        ScoredMoveList moves(buffer);
+        for (Board &b : corpus) {
+            b.getAllPseudoLegalMoves(moves, b.getPlayerToMove());
+            acc += moves.size();
+        }
+        sink += acc;
+        return (uint64_t) corpus.size();
+    });
+
+    runBenchmark("getAllLegalMove", []() {
+        uint64_t acc = 0;
+        ScoredMove buffer[MAX_MOVES];
+        ScoredMoveList moves(buffer);
+        for (Board &b : corpus) {
+            b.getAllLegalMove(moves, b.getPlayerToMove());
+            acc += moves.size();
+        }
+        sink += acc;
+        return (uint64_t) corpus.size();
+    });
+
+    // doMove is timed on boards reset by plain assignment, which is cheap
+    // next to staticCopy and the move itself
+    static std::vector<Move> firstMoves;
+    static std::vector<Board> scratch;
+    ScoredMove buffer[MAX_MOVES];
+    ScoredMoveList moves(buffer);
+    for (Board &b : corpus) {
+        b.getAllLegalMove(moves, b.getPlayerToMove());
+        firstMoves.push_back(moves.get(0));
+        scratch.push_back(b);
+    }
+
+    runBenchmark("doMove", []() {
+        uint64_t acc = 0;
+        for (size_t i = 0; i < corpus.size(); i++) {
+            scratch[i] = corpus[i];
+            scratch[i].doMove(firstMoves[i], scratch[i].getPlayerToMove());
+            acc += scratch[i].getZobristKey();
+        }
+        sink += acc;
+        return (uint64_t) corpus.size();
+    });
+
+    runBenchmark("staticCopy", []() {
+        uint64_t acc = 0;
+        for (Board &b : corpus) {
+            Board copy = b.staticCopy();
+            acc += copy.getZobristKey();
+        }
+        sink += acc;
+        return (uint64_t) corpus.size();
+    });
+
+    runBenchmark("calculateZobristKey", []() {
+        uint64_t acc = 0;
+        for (Board &b : corpus)
+            acc += b.calculateZobristKey();
+        sink += acc;
+        return (uint64_t) corpus.size();
+    });
+
+    runBenchmark("getPinnedMap", []() {
+        uint64_t acc = 0;
+        for (Board &b : corpus)
+            acc ^= b.getPinnedMap(b.getPlayerToMove());
+        sink += acc;
+        return (uint64_t) corpus.size();
+    });
+
+    return 0;
+}
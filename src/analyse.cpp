@@ -0,0 +1,194 @@
+#include "analyse.h"
+#include "pgn.h"
+#include "search.h"
+#include "uci.h"
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct AnalyseOptions {
+    std::string input;
+    std::string output;
+    int depth;
+    uint64_t nodes;
+    int threads;
+};
+
+// Shared by the workers. Lines are handed out in file order and results are
+// held back until every earlier line has been written.
+struct AnalyseJob {
+    std::mutex mutex;
+    std::ifstream input;
+    std::ostream *output;
+    uint64_t nextLine;
+    uint64_t nextWrite;
+    std::map<uint64_t, std::string> finished;
+    uint64_t positions;
+    uint64_t nodes;
+    SearchStats stats;
+};
+
+static bool parseOptions(int argc, char **argv, AnalyseOptions &options) {
+    options.depth = DEFAULT_ANALYSE_DEPTH;
+    options.nodes = 0;
+    options.threads = std::max(1, (int) std::thread::hardware_concurrency());
+    bool valid = true;
+    for (int i = 0; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        std::string value = argv[i + 1];
+        if (option == "--input") options.input = value;
+        else if (option == "--output") options.output = value;
+        else if (option == "--depth") valid &= parseNumber(value, options.depth);
+        else if (option == "--nodes") valid &= parseNumber(value, options.nodes);
+        else if (option == "--threads") valid &= parseNumber(value, options.threads);
+        else {
+            std::cout << "Unknown option " << option << std::endl;
+            return false;
+        }
+    }
+    options.depth = std::max(1, std::min(MAX_DEPTH, options.depth));
+    options.threads = std::max(1, options.threads);
+    if (!valid || argc % 2 != 0 || options.input.empty()) {
+        std::cout << "Usage: brahma analyse --input FILE [--output FILE] [--depth N]"
+                  << " [--nodes N] [--threads N]" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// The four EPD fields of a FEN or EPD line, and the full FEN with any move
+// counters the line has
+static bool parsePosition(const std::string &line, std::string &epd, std::string &fen) {
+    std::istringstream stream(line);
+    std::string field;
+    int fields = 0;
+    epd.clear();
+    while (fields < 4 && stream >> field) {
+        epd += (fields ? " " : "") + field;
+        fields++;
+    }
+    if (fields < 4)
+        return false;
+
+    fen = epd;
+    std::string counters;
+    for (int i = 0; i < 2 && stream >> field && field.find_first_not_of("0123456789") == std::string::npos; i++)
+        counters += " " + field;
+    fen += counters.empty() ? " 0 1" : counters;
+    return true;
+}
+
+// Mates are ce +-MATE_SCORE with dm giving the full moves to mate, negative
+// when the side to move is mated
+static std::string scoreOpcodes(int score) {
+    if (!isMateScore(score))
+        return "ce " + std::to_string(score) + ";";
+    return "ce " + std::to_string(score > 0 ? MATE_SCORE : -MATE_SCORE)
+         + "; dm " + std::to_string(mateInMoves(score)) + ";";
+}
+
+static std::string analysePosition(Searcher &searcher, const std::string &line,
+        const AnalyseOptions &options, uint64_t &nodes) {
+    std::string epd, fen;
+    if (!parsePosition(line, epd, fen))
+        return "";
+
+    Board b = fenToBoard(fen);
+    // Every position starts cold so results do not depend on scheduling
+    searcher.clearCaches();
+    searcher.clearStop();
+    searcher.setGameHistory(std::vector<uint64_t>());
+    SearchLimits limits;
+    limits.depth = options.depth;
+    limits.nodes = options.nodes;
+    Move bestMove = searcher.getBestMove(b, limits);
+    nodes = searcher.getNodes();
+
+    if (bestMove == NULL_MOVE) {
+        if (b.isInCheck(b.getPlayerToMove()))
+            return epd + " ce " + std::to_string(-MATE_SCORE) + "; dm 0; acd 0; acn 0;\n";
+        return epd + " ce 0; acd 0; acn 0;\n";
+    }
+    return epd + " bm " + moveToSAN(b, bestMove) + "; " + scoreOpcodes(searcher.getScore())
+         + " acd " + std::to_string(searcher.getDepth()) + "; acn " + std::to_string(nodes) + ";\n";
+}
+
+static void runWorker(const AnalyseOptions &options, AnalyseJob &job) {
+    Searcher searcher;
+    searcher.setPrintInfo(false);
+    std::string line;
+    while (true) {
+        uint64_t index;
+        {
+            std::lock_guard<std::mutex> lock(job.mutex);
+            if (!std::getline(job.input, line))
+                break;
+            index = job.nextLine++;
+        }
+
+        uint64_t nodes = 0;
+        std::string result = analysePosition(searcher, line, options, nodes);
+
+        std::lock_guard<std::mutex> lock(job.mutex);
+        job.finished[index] = result;
+        job.nodes += nodes;
+        if (!result.empty())
+            job.positions++;
+        for (auto it = job.finished.find(job.nextWrite); it != job.finished.end();
+                it = job.finished.find(++job.nextWrite)) {
+            *job.output << it->second;
+            job.finished.erase(it);
+        }
+        job.output->flush();
+    }
+
+    std::lock_guard<std::mutex> lock(job.mutex);
+    job.stats += searcher.getStats();
+}
+
+int runAnalyse(int argc, char **argv) {
+    AnalyseOptions options;
+    if (!parseOptions(argc, argv, options))
+        return 1;
+
+    AnalyseJob job;
+    job.input.open(options.input);
+    if (!job.input.is_open()) {
+        std::cout << "Cannot open " << options.input << std::endl;
+        return 1;
+    }
+    std::ofstream file;
+    job.output = &std::cout;
+    if (!options.output.empty()) {
+        file.open(options.output);
+        if (!file.is_open()) {
+            std::cout << "Cannot open " << options.output << std::endl;
+            return 1;
+        }
+        job.output = &file;
+    }
+    job.nextLine = job.nextWrite = 0;
+    job.positions = job.nodes = 0;
+
+    ChessTime startTime = ChessClock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < options.threads; t++)
+        workers.push_back(std::thread(runWorker, std::cref(options), std::ref(job)));
+    for (std::thread &worker : workers)
+        worker.join();
+
+    // Kept off standard output, which may be carrying the results
+    uint64_t elapsed = getTimeElapsed(startTime);
+    std::cerr << "positions " << job.positions << " nodes " << job.nodes
+              << " nps " << job.nodes * 1000 / (elapsed ? elapsed : 1)
+              << " time " << elapsed / 1000 << "s" << std::endl;
+#ifdef STATS
+    job.stats.print(std::cerr);
+#endif
+    return job.output->good() ? 0 : 1;
+}
@@ -0,0 +1,21 @@
+#ifndef __ANALYSE_H__
+#define __ANALYSE_H__
+
+// The bench depth, a fraction of a second per position
+const int DEFAULT_ANALYSE_DEPTH = 5;
+
+// Searches every position of a FEN or EPD file, one position per thread at
+// a time with each thread running its own single threaded search. Results
+// are written in input order as EPD with the bm (in SAN), ce, acd and acn
+// opcodes. ce is in centipawns for the side to move. A forced mate is
+// ce 32766 or -32766 plus dm, the full moves to mate, negative when the side
+// to move is mated and 0 if it already is. Tablebase wins and losses score
+// just short of that, as in the info lines. Options:
+//   --input FILE     positions to analyse
+//   --output FILE    results, standard output by default
+//   --depth N        search depth
+//   --nodes N        node limit per position, none by default
+//   --threads N      positions searched at once, all cores by default
+int runAnalyse(int argc, char **argv);
+
+#endif
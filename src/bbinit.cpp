@@ -1,24 +1,17 @@
 #include "bbinit.h"
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
-static uint64_t mseed = 0, mstate = 0;
-
-uint64_t magicRNG() {
-    uint64_t y = ((mstate << 57) | (mseed << 57)) >> 1;
-    mstate ^= mseed >> 17;
-    mstate ^= mstate << 3;
-
-    uint64_t temp = mseed;
-    mseed = mstate;
-    mstate = temp;
-
-    return (y | (mseed ^ mstate)) >> 1;
-}
-
-const int NORTH_SOUTH_FILL = 0;
+// Shift for one step along each ray direction
+const int NORTH_SOUTH_FILL = 8;
 const int EAST_WEST_FILL = 1;
 const int NE_SW_FILL = 9;
 const int NW_SE_FILL = 7;
 
+const uint64_t NOTAB = 0xFCFCFCFCFCFCFCFC;
+const uint64_t NOTGH = 0x3F3F3F3F3F3F3F3F;
+
 uint64_t fillRayRight(uint64_t rayPieces, uint64_t empty, int shift) {
     rayPieces |= empty & (rayPieces << shift);
     empty &= (empty << shift);
@@ -37,30 +30,70 @@ uint64_t fillRayLeft(uint64_t rayPieces, uint64_t empty, int shift) {
     return rayPieces;
 }
 
-static uint64_t ROOK_MASK[64];
-static uint64_t BISHOP_MASK[64];
+// Set-wise attacks: Kogge-Stone fills of every slider in the set at once.
+// Rays that step onto the A or H file have the far file masked out of the
+// empty squares, so they cannot wrap around the board.
+uint64_t rookSetAttacks(uint64_t rooks, uint64_t occ) {
+    uint64_t empty = ~occ;
+    uint64_t attacks = fillRayRight(rooks, empty, NORTH_SOUTH_FILL) << NORTH_SOUTH_FILL;
+    attacks |= fillRayLeft(rooks, empty, NORTH_SOUTH_FILL) >> NORTH_SOUTH_FILL;
+    attacks |= (fillRayRight(rooks, empty & NOTA, EAST_WEST_FILL) << EAST_WEST_FILL) & NOTA;
+    attacks |= (fillRayLeft(rooks, empty & NOTH, EAST_WEST_FILL) >> EAST_WEST_FILL) & NOTH;
+    return attacks;
+}
 
-uint64_t *attackTable;
+uint64_t bishopSetAttacks(uint64_t bishops, uint64_t occ) {
+    uint64_t empty = ~occ;
+    uint64_t attacks = (fillRayRight(bishops, empty & NOTA, NE_SW_FILL) << NE_SW_FILL) & NOTA;
+    attacks |= (fillRayLeft(bishops, empty & NOTH, NE_SW_FILL) >> NE_SW_FILL) & NOTH;
+    attacks |= (fillRayRight(bishops, empty & NOTH, NW_SE_FILL) << NW_SE_FILL) & NOTH;
+    attacks |= (fillRayLeft(bishops, empty & NOTA, NW_SE_FILL) >> NW_SE_FILL) & NOTA;
+    return attacks;
+}
 
-MagicInfo magicBishops[64];
-MagicInfo magicRooks[64];
+#ifdef __AVX2__
+// Four directions per vector: north, east, north-east and north-west fill
+// with left shifts, and their opposites with right shifts
+uint64_t sliderSetAttacks(uint64_t rooks, uint64_t bishops, uint64_t occ) {
+    const __m256i shift1 = _mm256_setr_epi64x(NORTH_SOUTH_FILL, EAST_WEST_FILL, NE_SW_FILL, NW_SE_FILL);
+    const __m256i shift2 = _mm256_slli_epi64(shift1, 1);
+    const __m256i shift4 = _mm256_slli_epi64(shift1, 2);
+    const __m256i leftMask = _mm256_setr_epi64x(-1, NOTA, NOTA, NOTH);
+    const __m256i rightMask = _mm256_setr_epi64x(-1, NOTH, NOTH, NOTA);
+    __m256i sliders = _mm256_setr_epi64x(rooks, rooks, bishops, bishops);
+    __m256i empty = _mm256_set1_epi64x(~occ);
 
-uint64_t inBetweenSqs[64][64];
+    __m256i gen = sliders;
+    __m256i pro = _mm256_and_si256(empty, leftMask);
+    gen = _mm256_or_si256(gen, _mm256_and_si256(pro, _mm256_sllv_epi64(gen, shift1)));
+    pro = _mm256_and_si256(pro, _mm256_sllv_epi64(pro, shift1));
+    gen = _mm256_or_si256(gen, _mm256_and_si256(pro, _mm256_sllv_epi64(gen, shift2)));
+    pro = _mm256_and_si256(pro, _mm256_sllv_epi64(pro, shift2));
+    gen = _mm256_or_si256(gen, _mm256_and_si256(pro, _mm256_sllv_epi64(gen, shift4)));
+    __m256i attacks = _mm256_and_si256(_mm256_sllv_epi64(gen, shift1), leftMask);
 
-uint64_t indexToMask64(int index, int nBits, uint64_t mask);
-uint64_t ratt(int sq, uint64_t block);
-uint64_t batt(int sq, uint64_t block);
-int magicMap(uint64_t masked, uint64_t magic, int nBits);
-uint64_t findMagic(int sq, int m, bool isBishop);
+    gen = sliders;
+    pro = _mm256_and_si256(empty, rightMask);
+    gen = _mm256_or_si256(gen, _mm256_and_si256(pro, _mm256_srlv_epi64(gen, shift1)));
+    pro = _mm256_and_si256(pro, _mm256_srlv_epi64(pro, shift1));
+    gen = _mm256_or_si256(gen, _mm256_and_si256(pro, _mm256_srlv_epi64(gen, shift2)));
+    pro = _mm256_and_si256(pro, _mm256_srlv_epi64(pro, shift2));
+    gen = _mm256_or_si256(gen, _mm256_and_si256(pro, _mm256_srlv_epi64(gen, shift4)));
+    attacks = _mm256_or_si256(attacks, _mm256_and_si256(_mm256_srlv_epi64(gen, shift1), rightMask));
 
-uint64_t indexToMask64(int index, int nBits, uint64_t mask) {
-    uint64_t result = 0;
-    for (int i = 0; i < nBits; i++) {
-        int j = bitScanForward(mask);
-        if (index & (1 << i)) result |= (1ULL << j);
-        mask &= mask - 1;
-    }
-    return result;
+    __m128i half = _mm_or_si128(_mm256_castsi256_si128(attacks), _mm256_extracti128_si256(attacks, 1));
+    return (uint64_t) (_mm_cvtsi128_si64(half) | _mm_extract_epi64(half, 1));
+}
+#else
+uint64_t sliderSetAttacks(uint64_t rooks, uint64_t bishops, uint64_t occ) {
+    return rookSetAttacks(rooks, occ) | bishopSetAttacks(bishops, occ);
+}
+#endif
+
+uint64_t knightSetAttacks(uint64_t knights) {
+    uint64_t oneFile = ((knights << 1) & NOTA) | ((knights >> 1) & NOTH);
+    uint64_t twoFiles = ((knights << 2) & NOTAB) | ((knights >> 2) & NOTGH);
+    return (oneFile << 16) | (oneFile >> 16) | (twoFiles << 8) | (twoFiles >> 8);
 }
 
 uint64_t ratt(int sq, uint64_t block) {
@@ -109,32 +142,91 @@ uint64_t batt(int sq, uint64_t block) {
     return result;
 }
 
+#ifndef LOWMEM
+static uint64_t mstate = 0;
+
+// The generator restarts from a per-rank seed for every square. These seeds
+// are known to reach a working magic for every square quickly, so the tables
+// build in a few tens of milliseconds.
+const uint64_t MAGIC_SEEDS[8] = {728, 10316, 55013, 32803, 12281, 15100, 16645, 255};
+
+// xorshift64*
+uint64_t magicRNG() {
+    mstate ^= mstate >> 12;
+    mstate ^= mstate << 25;
+    mstate ^= mstate >> 27;
+    return mstate * 0x2545F4914F6CDD1DULL;
+}
+
+static uint64_t ROOK_MASK[64];
+static uint64_t BISHOP_MASK[64];
+
+uint64_t *attackTable;
+
+MagicInfo magicBishops[64];
+MagicInfo magicRooks[64];
+
+uint64_t inBetweenSqs[64][64];
+
+uint64_t indexToMask64(int index, int nBits, uint64_t mask);
+int magicMap(uint64_t masked, uint64_t magic, int nBits);
+uint64_t findMagic(int sq, int m, bool isBishop);
+
+uint64_t rookAttacks(int sq, uint64_t occ) {
+    const MagicInfo &m = magicRooks[sq];
+    return m.table[((occ & m.mask) * m.magic) >> m.shift];
+}
+
+uint64_t bishopAttacks(int sq, uint64_t occ) {
+    const MagicInfo &m = magicBishops[sq];
+    return m.table[((occ & m.mask) * m.magic) >> m.shift];
+}
+
+uint64_t inBetween(int sq1, int sq2) {
+    return inBetweenSqs[sq1][sq2];
+}
+
+uint64_t indexToMask64(int index, int nBits, uint64_t mask) {
+    uint64_t result = 0;
+    for (int i = 0; i < nBits; i++) {
+        int j = bitScanForward(mask);
+        if (index & (1 << i)) result |= (1ULL << j);
+        mask &= mask - 1;
+    }
+    return result;
+}
+
 int magicMap(uint64_t masked, uint64_t magic, int nBits) {
     return (int)((masked * magic) >> (64 - nBits));
 }
 
 uint64_t findMagic(int sq, int nBits, bool isBishop) {
-    uint64_t magic = 1;
-    for (int attempt = 0; attempt < 100000; attempt++) {
-        magic = magicRNG() & magicRNG() & magicRNG();
-        if (count((magic * (isBishop ? BISHOP_MASK[sq] : ROOK_MASK[sq])) & 0xFF00000000000000) < 6) continue;
-        
-        bool collision = false;
-        uint64_t used[4096] = {0};
-        uint64_t mask = isBishop ? BISHOP_MASK[sq] : ROOK_MASK[sq];
-        
-        for (int i = 0; !collision && i < (1 << nBits); i++) {
-            uint64_t occ = indexToMask64(i, nBits, mask);
-            uint64_t att = isBishop ? batt(sq, occ) : ratt(sq, occ);
-            int j = magicMap(occ, magic, nBits);
-            if (used[j] == 0) {
-                used[j] = att;
-            } else if (used[j] != att) {
-                collision = true;
+    uint64_t mask = isBishop ? BISHOP_MASK[sq] : ROOK_MASK[sq];
+    uint64_t occupancy[4096], attacks[4096], used[4096];
+    // A slot belongs to the current candidate when its epoch matches, which
+    // saves clearing the table for every candidate
+    int epoch[4096] = {0};
+    for (int i = 0; i < (1 << nBits); i++) {
+        occupancy[i] = indexToMask64(i, nBits, mask);
+        attacks[i] = isBishop ? batt(sq, occupancy[i]) : ratt(sq, occupancy[i]);
+    }
+
+    mstate = MAGIC_SEEDS[sq >> 3];
+    for (int attempt = 1; attempt < 100000000; attempt++) {
+        uint64_t magic = magicRNG() & magicRNG() & magicRNG();
+        if (count((magic * mask) & 0xFF00000000000000) < 6) continue;
+
+        int i = 0;
+        for (; i < (1 << nBits); i++) {
+            int j = magicMap(occupancy[i], magic, nBits);
+            if (epoch[j] < attempt) {
+                epoch[j] = attempt;
+                used[j] = attacks[i];
+            } else if (used[j] != attacks[i]) {
+                break;
             }
         }
-        
-        if (!collision) return magic;
+        if (i == (1 << nBits)) return magic;
     }
     return 0;
 }
@@ -159,10 +251,7 @@ void initInBetweenTable() {
     }
 }
 
-void initMagicTables(uint64_t seed) {
-    mstate = 74036198046ULL;
-    mseed = seed;
-    
+void initMagicTables() {
     for (int i = 0; i < 64; ++i) {
         uint64_t relevantBits = ((~FILES[0] & ~FILES[7]) | FILES[i & 7])
             & ((~RANKS[0] & ~RANKS[7]) | RANKS[i >> 3]);
@@ -218,3 +307,67 @@ void initMagicTables(uint64_t seed) {
         }
     }
 }
+#else
+// Hyperbola quintessence: with the line masked out of the occupancy,
+// subtracting the slider borrows through the empty squares up to the first
+// blocker above it. Doing the same on the byte-swapped board finds the first
+// blocker below it. A byte swap does not mirror a rank, so rank attacks fill
+// outwards from the slider instead.
+static uint64_t lineAttacks(int sq, uint64_t occ, uint64_t mask) {
+    uint64_t slider = indexToBit(sq);
+    uint64_t forward = occ & mask;
+    uint64_t reverse = flipAcrossRanks(forward);
+    forward -= slider;
+    reverse -= flipAcrossRanks(slider);
+    return (forward ^ flipAcrossRanks(reverse)) & mask;
+}
+
+static uint64_t rankAttacks(int sq, uint64_t occ) {
+    uint64_t slider = indexToBit(sq);
+    uint64_t empty = ~occ;
+    return ((fillRayRight(slider, empty & NOTA, EAST_WEST_FILL) << EAST_WEST_FILL) & NOTA)
+         | ((fillRayLeft(slider, empty & NOTH, EAST_WEST_FILL) >> EAST_WEST_FILL) & NOTH);
+}
+
+static uint64_t diagonalMask(int sq) {
+    int diag = (sq & 7) - (sq >> 3);
+    return (diag >= 0) ? DIAGONAL >> (8 * diag) : DIAGONAL << (-8 * diag);
+}
+
+static uint64_t antiDiagonalMask(int sq) {
+    int diag = (sq & 7) + (sq >> 3) - 7;
+    return (diag >= 0) ? ANTIDIAGONAL << (8 * diag) : ANTIDIAGONAL >> (-8 * diag);
+}
+
+uint64_t rookAttacks(int sq, uint64_t occ) {
+    return lineAttacks(sq, occ, FILES[sq & 7] ^ indexToBit(sq)) | rankAttacks(sq, occ);
+}
+
+uint64_t bishopAttacks(int sq, uint64_t occ) {
+    return lineAttacks(sq, occ, diagonalMask(sq) ^ indexToBit(sq))
+         | lineAttacks(sq, occ, antiDiagonalMask(sq) ^ indexToBit(sq));
+}
+
+// Takes the line through both squares from its pattern starting at a1 and
+// shifts it to the lower square with a multiply, then keeps the part strictly
+// between them. Lines are chosen with arithmetic masks instead of branches.
+uint64_t inBetween(int sq1, int sq2) {
+    const uint64_t A2A7 = 0x0001010101010100;
+    const uint64_t B2G7 = 0x0040201008040200;
+    const uint64_t H1B7 = 0x0002040810204080;
+    uint64_t between = (~0ULL << sq1) ^ (~0ULL << sq2);
+    uint64_t file = (uint64_t) ((sq2 & 7) - (sq1 & 7));
+    uint64_t rank = (uint64_t) (((sq2 | 7) - sq1) >> 3);
+    uint64_t line = ((file & 7) - 1) & A2A7;
+    line += 2 * (((rank & 7) - 1) >> 58);
+    line += (((rank - file) & 15) - 1) & B2G7;
+    line += (((rank + file) & 15) - 1) & H1B7;
+    line *= between & -between;
+    return line & between;
+}
+
+// Nothing to build: attacks and in-between squares are computed on the fly
+void initInBetweenTable() {}
+
+void initMagicTables() {}
+#endif
@@ -105,10 +105,23 @@ struct MagicInfo {
     int shift;
 };
 
-void initMagicTables(uint64_t seed);
+void initMagicTables();
 void initInBetweenTable();
 
 uint64_t ratt(int sq, uint64_t block);
 uint64_t batt(int sq, uint64_t block);
 
+// Slider attacks and the squares strictly between two aligned squares. By
+// default these are looked up in magic and in-between tables (about 900 KB);
+// building with -DLOWMEM computes them without any tables.
+uint64_t rookAttacks(int sq, uint64_t occ);
+uint64_t bishopAttacks(int sq, uint64_t occ);
+uint64_t inBetween(int sq1, int sq2);
+
+// Combined attacks of a whole set of pieces, for attack maps over the board
+uint64_t rookSetAttacks(uint64_t rooks, uint64_t occ);
+uint64_t bishopSetAttacks(uint64_t bishops, uint64_t occ);
+uint64_t sliderSetAttacks(uint64_t rooks, uint64_t bishops, uint64_t occ);
+uint64_t knightSetAttacks(uint64_t knights);
+
 #endif
@@ -0,0 +1,17 @@
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include <cstdint>
+
+const int DEFAULT_BENCH_DEPTH = 5;
+// Node count at DEFAULT_BENCH_DEPTH. Update it with any commit that changes
+// the search on purpose.
+const uint64_t BENCH_SIGNATURE = 2621595;
+
+// Searches a fixed set of positions to the given depth. The total node count
+// is a signature of the search: any functional change alters it. At the
+// default depth it is checked against BENCH_SIGNATURE, returning 1 if it
+// differs.
+int runBench(int depth, int threads, int hashMB);
+
+#endif
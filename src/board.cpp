@@ -1,12 +1,76 @@
 #include "board.h"
 #include "bbinit.h"
+#include "eval.h"
+#include <algorithm>
 #include <cstring>
 
+// The king is worth more than anything an exchange could win
+const int SEE_VALUES[6] = {MATERIAL_VALUES[PAWNS], MATERIAL_VALUES[KNIGHTS], MATERIAL_VALUES[BISHOPS],
+                           MATERIAL_VALUES[ROOKS], MATERIAL_VALUES[QUEENS], 20000};
+
 static uint64_t zobristTable[781];
 static uint64_t zobristCastling[16];
 static uint64_t zobristEP[8];
 static uint64_t zobristSide;
 
+// Every reversible non-pawn move, keyed by the zobrist change it makes, in a
+// cuckoo hash table for detecting that a position can repeat in one move
+const int CUCKOO_SIZE = 8192;
+static uint64_t cuckooKeys[CUCKOO_SIZE];
+static Move cuckooMoves[CUCKOO_SIZE];
+
+// The zobrist keys come from an LCG whose low bits are weak, so the two hash
+// functions take the high bits of a multiplication instead of key slices
+static inline int cuckooH1(uint64_t key) {
+    return (int) ((key * 0xBF58476D1CE4E5B9ULL) >> 51);
+}
+
+static inline int cuckooH2(uint64_t key) {
+    return (int) ((key * 0x94D049BB133111EBULL) >> 51);
+}
+
+static uint64_t emptyBoardAttacks(int piece, int sq) {
+    switch (piece) {
+        case KNIGHTS: return KNIGHTMOVES[sq];
+        case BISHOPS: return batt(sq, 0);
+        case ROOKS: return ratt(sq, 0);
+        case QUEENS: return batt(sq, 0) | ratt(sq, 0);
+        default: return KINGMOVES[sq];
+    }
+}
+
+static void initCuckooTables() {
+    for (int i = 0; i < CUCKOO_SIZE; i++) {
+        cuckooKeys[i] = 0;
+        cuckooMoves[i] = NULL_MOVE;
+    }
+
+    for (int colour = WHITE; colour <= BLACK; colour++) {
+        for (int piece = KNIGHTS; piece <= KINGS; piece++) {
+            for (int sq1 = 0; sq1 < 64; sq1++) {
+                for (int sq2 = sq1 + 1; sq2 < 64; sq2++) {
+                    if (!(emptyBoardAttacks(piece, sq1) & indexToBit(sq2)))
+                        continue;
+                    Move m = encodeMove(sq1, sq2);
+                    uint64_t key = zobristTable[colour * 6 * 64 + piece * 64 + sq1]
+                                 ^ zobristTable[colour * 6 * 64 + piece * 64 + sq2]
+                                 ^ zobristSide;
+                    int i = cuckooH1(key);
+                    // Insert, evicting entries to their alternative slot
+                    // until an empty one is found
+                    while (true) {
+                        std::swap(cuckooKeys[i], key);
+                        std::swap(cuckooMoves[i], m);
+                        if (m == NULL_MOVE)
+                            break;
+                        i = (i == cuckooH1(key)) ? cuckooH2(key) : cuckooH1(key);
+                    }
+                }
+            }
+        }
+    }
+}
+
 void initZobristTable() {
     uint64_t seed = 1070372;
     for (int i = 0; i < 781; i++) {
@@ -28,36 +92,19 @@ void initZobristTable() {
     }
     
     zobristSide = seed;
+    initCuckooTables();
 }
 
 Board::Board() {
-    for (int i = 0; i < 2; i++) {
-        for (int j = 0; j < 6; j++) {
-            pieces[i][j] = 0;
-        }
-        allPieces[i] = 0;
-    }
-    
-    pieces[WHITE][PAWNS] = 0x000000000000FF00ULL;
-    pieces[WHITE][ROOKS] = 0x0000000000000081ULL;
-    pieces[WHITE][KNIGHTS] = 0x0000000000000042ULL;
-    pieces[WHITE][BISHOPS] = 0x0000000000000024ULL;
-    pieces[WHITE][QUEENS] = 0x0000000000000008ULL;
-    pieces[WHITE][KINGS] = 0x0000000000000010ULL;
-    
-    pieces[BLACK][PAWNS] = 0x00FF000000000000ULL;
-    pieces[BLACK][ROOKS] = 0x8100000000000000ULL;
-    pieces[BLACK][KNIGHTS] = 0x4200000000000000ULL;
-    pieces[BLACK][BISHOPS] = 0x2400000000000000ULL;
-    pieces[BLACK][QUEENS] = 0x0800000000000000ULL;
-    pieces[BLACK][KINGS] = 0x1000000000000000ULL;
-    
-    for (int i = 0; i < 2; i++) {
-        allPieces[i] = 0;
-        for (int j = 0; j < 6; j++) {
-            allPieces[i] |= pieces[i][j];
-        }
-    }
+    pieces[PAWNS] = 0x00FF00000000FF00ULL;
+    pieces[KNIGHTS] = 0x4200000000000042ULL;
+    pieces[BISHOPS] = 0x2400000000000024ULL;
+    pieces[ROOKS] = 0x8100000000000081ULL;
+    pieces[QUEENS] = 0x0800000000000008ULL;
+    pieces[KINGS] = 0x1000000000000010ULL;
+    allPieces[WHITE] = 0x000000000000FFFFULL;
+    allPieces[BLACK] = 0xFFFF000000000000ULL;
+    calculateMailbox();
     
     castlingRights = WHITECASTLE | BLACKCASTLE;
     epCaptureFile = NO_EP_POSSIBLE;
@@ -65,6 +112,8 @@ Board::Board() {
     moveNumber = 1;
     playerToMove = WHITE;
     zobristKey = calculateZobristKey();
+    pawnKey = calculatePawnKey();
+    calculateIncrementalState();
 }
 
 Board::Board(int *mailboxBoard, bool _whiteCanKCastle, bool _blackCanKCastle,
@@ -72,19 +121,17 @@ Board::Board(int *mailboxBoard, bool _whiteCanKCastle, bool _blackCanKCastle,
         uint16_t _epCaptureFile, int _fiftyMoveCounter, int _moveNumber,
         int _playerToMove) {
     
-    for (int i = 0; i < 2; i++) {
-        for (int j = 0; j < 6; j++) {
-            pieces[i][j] = 0;
-        }
-        allPieces[i] = 0;
-    }
+    for (int i = 0; i < 6; i++)
+        pieces[i] = 0;
+    allPieces[WHITE] = allPieces[BLACK] = 0;
     
     for (int sq = 0; sq < 64; sq++) {
         int piece = mailboxBoard[sq];
+        mailbox[sq] = (int8_t) piece;
         if (piece != -1) {
             int color = piece / 6;
             int pieceType = piece % 6;
-            pieces[color][pieceType] |= indexToBit(sq);
+            pieces[pieceType] |= indexToBit(sq);
             allPieces[color] |= indexToBit(sq);
         }
     }
@@ -100,21 +147,94 @@ Board::Board(int *mailboxBoard, bool _whiteCanKCastle, bool _blackCanKCastle,
     moveNumber = _moveNumber;
     playerToMove = _playerToMove;
     zobristKey = calculateZobristKey();
+    pawnKey = calculatePawnKey();
+    calculateIncrementalState();
 }
 
 Board::~Board() {}
 
 Board Board::staticCopy() {
-    Board copy;
-    memcpy(copy.pieces, pieces, sizeof(pieces));
-    memcpy(copy.allPieces, allPieces, sizeof(allPieces));
-    copy.castlingRights = castlingRights;
-    copy.epCaptureFile = epCaptureFile;
-    copy.fiftyMoveCounter = fiftyMoveCounter;
-    copy.moveNumber = moveNumber;
-    copy.playerToMove = playerToMove;
-    copy.zobristKey = zobristKey;
-    return copy;
+    return *this;
+}
+
+void Board::calculateMailbox() {
+    for (int sq = 0; sq < 64; sq++)
+        mailbox[sq] = -1;
+    for (int colour = 0; colour < 2; colour++) {
+        for (int piece = 0; piece < 6; piece++) {
+            uint64_t bb = getPieces(colour, piece);
+            while (bb) {
+                mailbox[bitScanForward(bb)] = (int8_t) (colour * 6 + piece);
+                bb &= bb - 1;
+            }
+        }
+    }
+}
+
+void Board::calculateIncrementalState() {
+    dirty.count = 0;
+    psqtScore = SCORE_ZERO;
+    material[WHITE] = material[BLACK] = 0;
+    for (int colour = 0; colour < 2; colour++) {
+        for (int piece = 0; piece < 6; piece++) {
+            uint64_t bb = getPieces(colour, piece);
+            while (bb) {
+                int sq = bitScanForward(bb);
+                psqtScore += pieceSquareTable[colour][piece][sq];
+                material[colour] += MATERIAL_VALUES[piece];
+                bb &= bb - 1;
+            }
+        }
+    }
+}
+
+void Board::addPiece(int colour, int piece, int sq) {
+    pieces[piece] |= indexToBit(sq);
+    allPieces[colour] |= indexToBit(sq);
+    mailbox[sq] = (int8_t) (colour * 6 + piece);
+    uint64_t keyChange = zobristTable[colour * 6 * 64 + piece * 64 + sq];
+    zobristKey ^= keyChange;
+    if (piece == PAWNS)
+        pawnKey ^= keyChange;
+    psqtScore += pieceSquareTable[colour][piece][sq];
+    material[colour] += MATERIAL_VALUES[piece];
+    recordDirty(colour * 6 + piece, NO_SQUARE, sq);
+}
+
+void Board::removePiece(int colour, int piece, int sq) {
+    pieces[piece] &= ~indexToBit(sq);
+    allPieces[colour] &= ~indexToBit(sq);
+    mailbox[sq] = -1;
+    uint64_t keyChange = zobristTable[colour * 6 * 64 + piece * 64 + sq];
+    zobristKey ^= keyChange;
+    if (piece == PAWNS)
+        pawnKey ^= keyChange;
+    psqtScore -= pieceSquareTable[colour][piece][sq];
+    material[colour] -= MATERIAL_VALUES[piece];
+    recordDirty(colour * 6 + piece, sq, NO_SQUARE);
+}
+
+void Board::movePiece(int colour, int piece, int startSq, int endSq) {
+    uint64_t moveBits = indexToBit(startSq) | indexToBit(endSq);
+    pieces[piece] ^= moveBits;
+    allPieces[colour] ^= moveBits;
+    mailbox[endSq] = mailbox[startSq];
+    mailbox[startSq] = -1;
+    uint64_t keyChange = zobristTable[colour * 6 * 64 + piece * 64 + startSq]
+                       ^ zobristTable[colour * 6 * 64 + piece * 64 + endSq];
+    zobristKey ^= keyChange;
+    if (piece == PAWNS)
+        pawnKey ^= keyChange;
+    psqtScore += pieceSquareTable[colour][piece][endSq]
+               - pieceSquareTable[colour][piece][startSq];
+    recordDirty(colour * 6 + piece, startSq, endSq);
+}
+
+void Board::recordDirty(int piece, int from, int to) {
+    dirty.piece[dirty.count] = piece;
+    dirty.from[dirty.count] = from;
+    dirty.to[dirty.count] = to;
+    dirty.count++;
 }
 
 uint64_t Board::calculateZobristKey() {
@@ -122,7 +242,7 @@ uint64_t Board::calculateZobristKey() {
     
     for (int color = 0; color < 2; color++) {
         for (int piece = 0; piece < 6; piece++) {
-            uint64_t bb = pieces[color][piece];
+            uint64_t bb = getPieces(color, piece);
             while (bb) {
                 int sq = bitScanForward(bb);
                 key ^= zobristTable[color * 6 * 64 + piece * 64 + sq];
@@ -144,72 +264,53 @@ uint64_t Board::calculateZobristKey() {
     return key;
 }
 
-void Board::doMove(Move m, int colour) {
-    int startSq = getStartSq(m);
-    int endSq = getEndSq(m);
-    uint64_t startBit = indexToBit(startSq);
-    uint64_t endBit = indexToBit(endSq);
+uint64_t Board::calculatePawnKey() {
+    uint64_t key = 0;
     
-    int pieceType = -1;
-    for (int p = 0; p < 6; p++) {
-        if (pieces[colour][p] & startBit) {
-            pieceType = p;
-            break;
+    for (int color = 0; color < 2; color++) {
+        uint64_t bb = getPieces(color, PAWNS);
+        while (bb) {
+            int sq = bitScanForward(bb);
+            key ^= zobristTable[color * 6 * 64 + PAWNS * 64 + sq];
+            bb &= bb - 1;
         }
     }
     
-    pieces[colour][pieceType] &= ~startBit;
-    pieces[colour][pieceType] |= endBit;
-    allPieces[colour] &= ~startBit;
-    allPieces[colour] |= endBit;
+    return key;
+}
+
+void Board::doMove(Move m, int colour) {
+    int startSq = getStartSq(m);
+    int endSq = getEndSq(m);
+    int pieceType = getPieceOnSquare(colour, startSq);
+    dirty.count = 0;
     
-    if (isCapture(m)) {
-        int opponent = 1 - colour;
-        for (int p = 0; p < 6; p++) {
-            if (pieces[opponent][p] & endBit) {
-                pieces[opponent][p] &= ~endBit;
-                allPieces[opponent] &= ~endBit;
-                break;
-            }
-        }
+    zobristKey ^= zobristCastling[castlingRights];
+    if (epCaptureFile != NO_EP_POSSIBLE) {
+        zobristKey ^= zobristEP[epCaptureFile];
     }
     
-    if (isCastle(m)) {
-        if (endSq == 6) {
-            pieces[WHITE][ROOKS] &= ~indexToBit(7);
-            pieces[WHITE][ROOKS] |= indexToBit(5);
-            allPieces[WHITE] &= ~indexToBit(7);
-            allPieces[WHITE] |= indexToBit(5);
-        } else if (endSq == 2) {
-            pieces[WHITE][ROOKS] &= ~indexToBit(0);
-            pieces[WHITE][ROOKS] |= indexToBit(3);
-            allPieces[WHITE] &= ~indexToBit(0);
-            allPieces[WHITE] |= indexToBit(3);
-        } else if (endSq == 62) {
-            pieces[BLACK][ROOKS] &= ~indexToBit(63);
-            pieces[BLACK][ROOKS] |= indexToBit(61);
-            allPieces[BLACK] &= ~indexToBit(63);
-            allPieces[BLACK] |= indexToBit(61);
-        } else if (endSq == 58) {
-            pieces[BLACK][ROOKS] &= ~indexToBit(56);
-            pieces[BLACK][ROOKS] |= indexToBit(59);
-            allPieces[BLACK] &= ~indexToBit(56);
-            allPieces[BLACK] |= indexToBit(59);
-        }
+    if (isCapture(m) && !isEP(m)) {
+        removePiece(1 - colour, getPieceOnSquare(1 - colour, endSq), endSq);
     }
     
     if (isPromotion(m)) {
-        int promoType = getPromotion(m);
-        pieces[colour][PAWNS] &= ~endBit;
-        pieces[colour][promoType] |= endBit;
+        removePiece(colour, PAWNS, startSq);
+        addPiece(colour, getPromotion(m), endSq);
+    } else {
+        movePiece(colour, pieceType, startSq, endSq);
+    }
+    
+    if (isCastle(m)) {
+        if (endSq == 6) movePiece(WHITE, ROOKS, 7, 5);
+        else if (endSq == 2) movePiece(WHITE, ROOKS, 0, 3);
+        else if (endSq == 62) movePiece(BLACK, ROOKS, 63, 61);
+        else if (endSq == 58) movePiece(BLACK, ROOKS, 56, 59);
     }
     
     if (isEP(m)) {
         int captureRank = (colour == WHITE) ? 4 : 3;
-        int captureSq = captureRank * 8 + (endSq & 7);
-        uint64_t captureBit = indexToBit(captureSq);
-        pieces[1 - colour][PAWNS] &= ~captureBit;
-        allPieces[1 - colour] &= ~captureBit;
+        removePiece(1 - colour, PAWNS, captureRank * 8 + (endSq & 7));
     }
     
     if (pieceType == KINGS) {
@@ -221,11 +322,17 @@ void Board::doMove(Move m, int colour) {
         if (startSq == 56) castlingRights &= ~BLACKQSIDE;
         if (startSq == 63) castlingRights &= ~BLACKKSIDE;
     }
+    if (endSq == 0) castlingRights &= ~WHITEQSIDE;
+    if (endSq == 7) castlingRights &= ~WHITEKSIDE;
+    if (endSq == 56) castlingRights &= ~BLACKQSIDE;
+    if (endSq == 63) castlingRights &= ~BLACKKSIDE;
     
     epCaptureFile = NO_EP_POSSIBLE;
     if (pieceType == PAWNS && abs(endSq - startSq) == 16) {
         epCaptureFile = endSq & 7;
+        zobristKey ^= zobristEP[epCaptureFile];
     }
+    zobristKey ^= zobristCastling[castlingRights];
     
     if (pieceType == PAWNS || isCapture(m)) {
         fiftyMoveCounter = 0;
@@ -238,11 +345,11 @@ void Board::doMove(Move m, int colour) {
     }
     
     playerToMove = 1 - playerToMove;
-    zobristKey = calculateZobristKey();
+    zobristKey ^= zobristSide;
 }
 
 bool Board::isInCheck(int colour) {
-    uint64_t kingBB = pieces[colour][KINGS];
+    uint64_t kingBB = getPieces(colour, KINGS);
     if (!kingBB) return false;
     
     int kingSq = bitScanForward(kingBB);
@@ -250,20 +357,22 @@ bool Board::isInCheck(int colour) {
 }
 
 bool Board::isSquareAttacked(int sq, int byColour) {
-    uint64_t occ = allPieces[WHITE] | allPieces[BLACK];
-    
+    return isSquareAttacked(sq, byColour, allPieces[WHITE] | allPieces[BLACK]);
+}
+
+bool Board::isSquareAttacked(int sq, int byColour, uint64_t occ) {
     uint64_t pawnAttacks = getPawnAttacks(sq, 1 - byColour);
-    if (pawnAttacks & pieces[byColour][PAWNS]) return true;
+    if (pawnAttacks & getPieces(byColour, PAWNS)) return true;
     
-    if (KNIGHTMOVES[sq] & pieces[byColour][KNIGHTS]) return true;
+    if (KNIGHTMOVES[sq] & getPieces(byColour, KNIGHTS)) return true;
     
-    if (KINGMOVES[sq] & pieces[byColour][KINGS]) return true;
+    if (KINGMOVES[sq] & getPieces(byColour, KINGS)) return true;
     
     uint64_t rookAttacks = getRookAttacks(sq, occ);
-    if (rookAttacks & (pieces[byColour][ROOKS] | pieces[byColour][QUEENS])) return true;
+    if (rookAttacks & getRooksAndQueens(byColour)) return true;
     
     uint64_t bishopAttacks = getBishopAttacks(sq, occ);
-    if (bishopAttacks & (pieces[byColour][BISHOPS] | pieces[byColour][QUEENS])) return true;
+    if (bishopAttacks & getBishopsAndQueens(byColour)) return true;
     
     return false;
 }
@@ -271,26 +380,26 @@ bool Board::isSquareAttacked(int sq, int byColour) {
 uint64_t Board::getPawnAttacks(int sq, int colour) {
     if (colour == WHITE) {
         uint64_t attacks = 0;
-        if (sq >= 8 && (sq & 7) != 0) attacks |= indexToBit(sq + 7);
-        if (sq >= 8 && (sq & 7) != 7) attacks |= indexToBit(sq + 9);
+        if (sq < 56 && (sq & 7) != 0) attacks |= indexToBit(sq + 7);
+        if (sq < 56 && (sq & 7) != 7) attacks |= indexToBit(sq + 9);
         return attacks;
     } else {
         uint64_t attacks = 0;
-        if (sq < 56 && (sq & 7) != 0) attacks |= indexToBit(sq - 9);
-        if (sq < 56 && (sq & 7) != 7) attacks |= indexToBit(sq - 7);
+        if (sq >= 8 && (sq & 7) != 0) attacks |= indexToBit(sq - 9);
+        if (sq >= 8 && (sq & 7) != 7) attacks |= indexToBit(sq - 7);
         return attacks;
     }
 }
 
 uint64_t Board::getRookAttacks(int sq, uint64_t occ) {
-    return ratt(sq, occ);
+    return rookAttacks(sq, occ);
 }
 
 uint64_t Board::getBishopAttacks(int sq, uint64_t occ) {
-    return batt(sq, occ);
+    return bishopAttacks(sq, occ);
 }
 
-void Board::getAllPseudoLegalMoves(MoveList &moves, int colour) {
+void Board::getAllPseudoLegalMoves(ScoredMoveList &moves, int colour) {
     moves.clear();
     uint64_t occupied = allPieces[WHITE] | allPieces[BLACK];
     uint64_t friendly = allPieces[colour];
@@ -309,8 +418,8 @@ void Board::getAllPseudoLegalMoves(MoveList &moves, int colour) {
     generateKingMoves(moves, colour, occupied, friendly);
 }
 
-void Board::generatePawnMoves(MoveList &moves, int colour, uint64_t occupied, uint64_t enemy) {
-    uint64_t pawns = pieces[colour][PAWNS];
+void Board::generatePawnMoves(ScoredMoveList &moves, int colour, uint64_t occupied, uint64_t enemy) {
+    uint64_t pawns = getPieces(colour, PAWNS);
     int forward = (colour == WHITE) ? 8 : -8;
     int promoRank = (colour == WHITE) ? 6 : 1;
     
@@ -333,8 +442,9 @@ void Board::generatePawnMoves(MoveList &moves, int colour, uint64_t occupied, ui
     }
     
     uint64_t startingPawns = pawns & ((colour == WHITE) ? RANKS[1] : RANKS[6]);
-    uint64_t doublePushTargets = (colour == WHITE) ? 
-        (startingPawns << 16) & ~occupied : (startingPawns >> 16) & ~occupied;
+    uint64_t doublePushTargets = (colour == WHITE) ?
+        (((startingPawns << 8) & ~occupied) << 8) & ~occupied :
+        (((startingPawns >> 8) & ~occupied) >> 8) & ~occupied;
     
     while (doublePushTargets) {
         int to = bitScanForward(doublePushTargets);
@@ -356,7 +466,7 @@ void Board::generatePawnMoves(MoveList &moves, int colour, uint64_t occupied, ui
     }
 }
 
-void Board::generatePawnCaptures(MoveList &moves, uint64_t captures, int, int fromOffset, int promoRank) {
+void Board::generatePawnCaptures(ScoredMoveList &moves, uint64_t captures, int, int fromOffset, int promoRank) {
     while (captures) {
         int to = bitScanForward(captures);
         int from = to + fromOffset;
@@ -373,11 +483,11 @@ void Board::generatePawnCaptures(MoveList &moves, uint64_t captures, int, int fr
     }
 }
 
-void Board::generateEnPassantMoves(MoveList &moves, int colour) {
+void Board::generateEnPassantMoves(ScoredMoveList &moves, int colour) {
     int epRank = (colour == WHITE) ? 4 : 3;
     int epSquare = epRank * 8 + epCaptureFile;
     
-    uint64_t epCandidates = pieces[colour][PAWNS] & RANKS[epRank];
+    uint64_t epCandidates = getPieces(colour, PAWNS) & RANKS[epRank];
     if (epCandidates & indexToBit(epSquare - 1) && (epSquare & 7) != 0) {
         moves.add(setFlags(encodeMove(epSquare - 1, epSquare + ((colour == WHITE) ? 8 : -8)), MOVE_EP));
     }
@@ -387,8 +497,8 @@ void Board::generateEnPassantMoves(MoveList &moves, int colour) {
 }
 
 template<int PieceType>
-void Board::generatePieceMoves(MoveList &moves, int colour, uint64_t occupied, uint64_t friendly) {
-    uint64_t pieces_bb = pieces[colour][PieceType];
+void Board::generatePieceMoves(ScoredMoveList &moves, int colour, uint64_t occupied, uint64_t friendly) {
+    uint64_t pieces_bb = getPieces(colour, PieceType);
     
     while (pieces_bb) {
         int from = bitScanForward(pieces_bb);
@@ -428,29 +538,29 @@ void Board::generatePieceMoves(MoveList &moves, int colour, uint64_t occupied, u
     }
 }
 
-void Board::generateKnightMoves(MoveList &moves, int colour, uint64_t friendly) {
+void Board::generateKnightMoves(ScoredMoveList &moves, int colour, uint64_t friendly) {
     generatePieceMoves<KNIGHTS>(moves, colour, 0, friendly);
 }
 
-void Board::generateBishopMoves(MoveList &moves, int colour, uint64_t occupied, uint64_t friendly) {
+void Board::generateBishopMoves(ScoredMoveList &moves, int colour, uint64_t occupied, uint64_t friendly) {
     generatePieceMoves<BISHOPS>(moves, colour, occupied, friendly);
 }
 
-void Board::generateRookMoves(MoveList &moves, int colour, uint64_t occupied, uint64_t friendly) {
+void Board::generateRookMoves(ScoredMoveList &moves, int colour, uint64_t occupied, uint64_t friendly) {
     generatePieceMoves<ROOKS>(moves, colour, occupied, friendly);
 }
 
-void Board::generateQueenMoves(MoveList &moves, int colour, uint64_t occupied, uint64_t friendly) {
+void Board::generateQueenMoves(ScoredMoveList &moves, int colour, uint64_t occupied, uint64_t friendly) {
     generatePieceMoves<QUEENS>(moves, colour, occupied, friendly);
 }
 
-void Board::generateKingMoves(MoveList &moves, int colour, uint64_t, uint64_t friendly) {
+void Board::generateKingMoves(ScoredMoveList &moves, int colour, uint64_t, uint64_t friendly) {
     generatePieceMoves<KINGS>(moves, colour, 0, friendly);
     
     generateCastlingMoves(moves, colour);
 }
 
-void Board::generateCastlingMoves(MoveList &moves, int colour) {
+void Board::generateCastlingMoves(ScoredMoveList &moves, int colour) {
     if (isInCheck(colour)) return;
     
     uint64_t occupied = allPieces[WHITE] | allPieces[BLACK];
@@ -483,46 +593,86 @@ bool Board::canCastle(int colour, bool kingside) {
     }
 }
 
-void Board::getPseudoLegalQuiets(MoveList &quiets, int colour) {
-    MoveList allMoves;
-    getAllPseudoLegalMoves(allMoves, colour);
-    
-    quiets.clear();
-    for (unsigned int i = 0; i < allMoves.size(); i++) {
-        Move move = allMoves.get(i);
-        if (!isCapture(move)) {
-            quiets.add(move);
+void Board::getPseudoLegalQuiets(ScoredMoveList &quiets, int colour) {
+    getAllPseudoLegalMoves(quiets, colour);
+    
+    unsigned int kept = 0;
+    for (unsigned int i = 0; i < quiets.size(); i++) {
+        if (!isCapture(quiets.get(i))) {
+            quiets.swap(kept, i);
+            kept++;
         }
     }
+    quiets.resize(kept);
 }
 
-void Board::getPseudoLegalCaptures(MoveList &captures, int colour, bool includePromotions) {
-    MoveList allMoves;
-    getAllPseudoLegalMoves(allMoves, colour);
-    
+// Generates captures directly rather than filtering the full move list.
+// Promotions are restricted to queens since underpromotions are almost
+// never useful in quiescence.
+void Board::getPseudoLegalCaptures(ScoredMoveList &captures, int colour, bool includePromotions) {
     captures.clear();
-    for (unsigned int i = 0; i < allMoves.size(); i++) {
-        Move move = allMoves.get(i);
-        if (isCapture(move) || (includePromotions && isPromotion(move))) {
-            captures.add(move);
+    uint64_t occupied = allPieces[WHITE] | allPieces[BLACK];
+    uint64_t enemy = allPieces[1 - colour];
+    uint64_t pawns = getPieces(colour, PAWNS);
+    uint64_t lastRank = (colour == WHITE) ? RANK_8 : RANK_1;
+    
+    uint64_t leftCaptures = (colour == WHITE) ? 
+        ((pawns & NOTA) << 7) & enemy : ((pawns & NOTA) >> 9) & enemy;
+    uint64_t rightCaptures = (colour == WHITE) ? 
+        ((pawns & NOTH) << 9) & enemy : ((pawns & NOTH) >> 7) & enemy;
+    
+    while (leftCaptures) {
+        int to = bitScanForward(leftCaptures);
+        Move move = setCapture(encodeMove(to + ((colour == WHITE) ? -7 : 9), to), true);
+        if (indexToBit(to) & lastRank)
+            move = setFlags(move, MOVE_PROMO_Q);
+        captures.add(move);
+        leftCaptures &= leftCaptures - 1;
+    }
+    while (rightCaptures) {
+        int to = bitScanForward(rightCaptures);
+        Move move = setCapture(encodeMove(to + ((colour == WHITE) ? -9 : 7), to), true);
+        if (indexToBit(to) & lastRank)
+            move = setFlags(move, MOVE_PROMO_Q);
+        captures.add(move);
+        rightCaptures &= rightCaptures - 1;
+    }
+    
+    if (includePromotions) {
+        uint64_t promotions = (colour == WHITE) ? 
+            (pawns << 8) & ~occupied & lastRank : (pawns >> 8) & ~occupied & lastRank;
+        while (promotions) {
+            int to = bitScanForward(promotions);
+            captures.add(setFlags(encodeMove(to + ((colour == WHITE) ? -8 : 8), to), MOVE_PROMO_Q));
+            promotions &= promotions - 1;
         }
     }
-}
-
-MoveList Board::getAllLegalMove(int colour) {
-    MoveList pseudoLegal;
-    MoveList legal;
     
-    getAllPseudoLegalMoves(pseudoLegal, colour);
+    if (epCaptureFile != NO_EP_POSSIBLE) {
+        generateEnPassantMoves(captures, colour);
+    }
     
-    for (unsigned int i = 0; i < pseudoLegal.size(); i++) {
-        Move move = pseudoLegal.get(i);
-        if (isLegalMove(move, colour)) {
-            legal.add(move);
+    // Passing the complement of the enemy pieces as "friendly" keeps only captures
+    generatePieceMoves<KNIGHTS>(captures, colour, 0, ~enemy);
+    generatePieceMoves<BISHOPS>(captures, colour, occupied, ~enemy);
+    generatePieceMoves<ROOKS>(captures, colour, occupied, ~enemy);
+    generatePieceMoves<QUEENS>(captures, colour, occupied, ~enemy);
+    generatePieceMoves<KINGS>(captures, colour, 0, ~enemy);
+}
+
+// The pseudo-legal moves are generated straight into legal and the illegal
+// ones squeezed out in place
+void Board::getAllLegalMove(ScoredMoveList &legal, int colour) {
+    getAllPseudoLegalMoves(legal, colour);
+    
+    unsigned int kept = 0;
+    for (unsigned int i = 0; i < legal.size(); i++) {
+        if (isLegalMove(legal.get(i), colour)) {
+            legal.swap(kept, i);
+            kept++;
         }
     }
-    
-    return legal;
+    legal.resize(kept);
 }
 
 bool Board::isLegalMove(Move move, int colour) {
@@ -533,7 +683,7 @@ bool Board::isLegalMove(Move move, int colour) {
 
 uint64_t Board::getPinnedMap(int colour) {
     uint64_t pinned = 0;
-    uint64_t kingBB = pieces[colour][KINGS];
+    uint64_t kingBB = getPieces(colour, KINGS);
     if (!kingBB) return 0;
     
     int kingSq = bitScanForward(kingBB);
@@ -541,11 +691,11 @@ uint64_t Board::getPinnedMap(int colour) {
     uint64_t enemies = allPieces[1 - colour];
     
     uint64_t rookAttackers = getRookAttacks(kingSq, enemies) & 
-                            (pieces[1 - colour][ROOKS] | pieces[1 - colour][QUEENS]);
+                            getRooksAndQueens(1 - colour);
     
     while (rookAttackers) {
         int attackerSq = bitScanForward(rookAttackers);
-        uint64_t between = inBetweenSqs[kingSq][attackerSq];
+        uint64_t between = inBetween(kingSq, attackerSq);
         uint64_t blockers = between & occupied;
         
         if (count(blockers) == 1 && (blockers & allPieces[colour])) {
@@ -555,11 +705,11 @@ uint64_t Board::getPinnedMap(int colour) {
     }
     
     uint64_t bishopAttackers = getBishopAttacks(kingSq, enemies) & 
-                              (pieces[1 - colour][BISHOPS] | pieces[1 - colour][QUEENS]);
+                              getBishopsAndQueens(1 - colour);
     
     while (bishopAttackers) {
         int attackerSq = bitScanForward(bishopAttackers);
-        uint64_t between = inBetweenSqs[kingSq][attackerSq];
+        uint64_t between = inBetween(kingSq, attackerSq);
         uint64_t blockers = between & occupied;
         
         if (count(blockers) == 1 && (blockers & allPieces[colour])) {
@@ -573,7 +723,7 @@ uint64_t Board::getPinnedMap(int colour) {
 
 bool Board::doPseudoLegalMove(Move m, int colour) {
     doMove(m, colour);
-    return true;
+    return !isInCheck(colour);
 }
 
 bool Board::doHashMove(Move m, int colour) {
@@ -581,6 +731,7 @@ bool Board::doHashMove(Move m, int colour) {
 }
 
 void Board::doNullMove() {
+    dirty.count = 0;
     playerToMove = 1 - playerToMove;
     zobristKey ^= zobristSide;
     if (epCaptureFile != NO_EP_POSSIBLE) {
@@ -600,7 +751,8 @@ void Board::undoNullMove(uint16_t _epCaptureFile) {
 
 PieceMoveList Board::getPieceMoveList(int colour) {
     PieceMoveList pml;
-    MoveList moves;
+    ScoredMove buffer[MAX_MOVES];
+    ScoredMoveList moves(buffer);
     getAllPseudoLegalMoves(moves, colour);
     
     for (unsigned int i = 0; i < moves.size(); i++) {
@@ -614,50 +766,120 @@ PieceMoveList Board::getPieceMoveList(int colour) {
     return pml;
 }
 
-void Board::getPseudoLegalPromotions(MoveList &moves, int colour) {
-    MoveList allMoves;
-    getAllPseudoLegalMoves(allMoves, colour);
+void Board::getPseudoLegalPromotions(ScoredMoveList &moves, int colour) {
+    getAllPseudoLegalMoves(moves, colour);
     
-    moves.clear();
-    for (unsigned int i = 0; i < allMoves.size(); i++) {
-        Move move = allMoves.get(i);
-        if (isPromotion(move)) {
-            moves.add(move);
+    unsigned int kept = 0;
+    for (unsigned int i = 0; i < moves.size(); i++) {
+        if (isPromotion(moves.get(i))) {
+            moves.swap(kept, i);
+            kept++;
         }
     }
+    moves.resize(kept);
 }
 
-void Board::getPseudoLegalChecks(MoveList &checks, int colour) {
-    MoveList allMoves;
-    getAllPseudoLegalMoves(allMoves, colour);
-    
+// The full line through two aligned squares, or 0 if they are not aligned
+static uint64_t lineThrough(int sq1, int sq2) {
+    int r1 = sq1 >> 3, f1 = sq1 & 7;
+    int r2 = sq2 >> 3, f2 = sq2 & 7;
+    if (r1 == r2) return RANKS[r1];
+    if (f1 == f2) return FILES[f1];
+    if (r1 - f1 == r2 - f2) {
+        int d = r1 - f1;
+        return (d >= 0) ? DIAGONAL << (8 * d) : DIAGONAL >> (-8 * d);
+    }
+    if (r1 + f1 == r2 + f2) {
+        int d = r1 + f1 - 7;
+        return (d >= 0) ? ANTIDIAGONAL << (8 * d) : ANTIDIAGONAL >> (-8 * d);
+    }
+    return 0;
+}
+
+// Generates quiet (non-capture, non-promotion) moves that give direct or
+// discovered check, using the enemy king's check maps instead of making
+// every move. Castling checks are not generated.
+void Board::getPseudoLegalChecks(ScoredMoveList &checks, int colour) {
     checks.clear();
-    for (unsigned int i = 0; i < allMoves.size(); i++) {
-        Move move = allMoves.get(i);
-        Board tempBoard = staticCopy();
-        tempBoard.doMove(move, colour);
-        if (tempBoard.isInCheck(1 - colour)) {
-            checks.add(move);
+    uint64_t occupied = allPieces[WHITE] | allPieces[BLACK];
+    uint64_t empty = ~occupied;
+    int kingSq = getKingSq(1 - colour);
+    uint64_t checkMaps[6] = {0};
+    getCheckMaps(1 - colour, checkMaps);
+    
+    // Our pieces that are the only blocker between one of our sliders and
+    // the enemy king
+    uint64_t discoverers = 0;
+    uint64_t sliders = (getRookAttacks(kingSq, allPieces[1 - colour])
+                        & getRooksAndQueens(colour))
+                     | (getBishopAttacks(kingSq, allPieces[1 - colour])
+                        & getBishopsAndQueens(colour));
+    while (sliders) {
+        uint64_t blockers = inBetween(kingSq, bitScanForward(sliders)) & occupied;
+        if (count(blockers) == 1 && (blockers & allPieces[colour]))
+            discoverers |= blockers;
+        sliders &= sliders - 1;
+    }
+    
+    uint64_t pawns = getPieces(colour, PAWNS);
+    uint64_t lastRank = (colour == WHITE) ? RANK_8 : RANK_1;
+    int forward = (colour == WHITE) ? 8 : -8;
+    uint64_t singlePushes = ((colour == WHITE) ? pawns << 8 : pawns >> 8) & empty & ~lastRank;
+    uint64_t startRank = (colour == WHITE) ? RANK_3 : RANK_6;
+    uint64_t doublePushes = ((colour == WHITE) ? (singlePushes & startRank) << 8
+                                               : (singlePushes & startRank) >> 8) & empty;
+    
+    while (singlePushes) {
+        int to = bitScanForward(singlePushes);
+        int from = to - forward;
+        if ((indexToBit(to) & checkMaps[PAWNS])
+         || ((indexToBit(from) & discoverers) && !(lineThrough(kingSq, from) & indexToBit(to))))
+            checks.add(encodeMove(from, to));
+        singlePushes &= singlePushes - 1;
+    }
+    while (doublePushes) {
+        int to = bitScanForward(doublePushes);
+        int from = to - 2 * forward;
+        if ((indexToBit(to) & checkMaps[PAWNS])
+         || ((indexToBit(from) & discoverers) && !(lineThrough(kingSq, from) & indexToBit(to))))
+            checks.add(setFlags(encodeMove(from, to), MOVE_DOUBLE_PAWN));
+        doublePushes &= doublePushes - 1;
+    }
+    
+    for (int piece = KNIGHTS; piece <= KINGS; piece++) {
+        uint64_t bb = getPieces(colour, piece);
+        while (bb) {
+            int from = bitScanForward(bb);
+            uint64_t attacks;
+            switch (piece) {
+                case KNIGHTS: attacks = KNIGHTMOVES[from]; break;
+                case BISHOPS: attacks = getBishopAttacks(from, occupied); break;
+                case ROOKS: attacks = getRookAttacks(from, occupied); break;
+                case QUEENS: attacks = getRookAttacks(from, occupied) | getBishopAttacks(from, occupied); break;
+                default: attacks = KINGMOVES[from]; break;
+            }
+            attacks &= empty;
+            
+            uint64_t targets = attacks & checkMaps[piece];
+            if (indexToBit(from) & discoverers)
+                targets |= attacks & ~lineThrough(kingSq, from);
+            
+            while (targets) {
+                checks.add(encodeMove(from, bitScanForward(targets)));
+                targets &= targets - 1;
+            }
+            bb &= bb - 1;
         }
     }
 }
 
-void Board::getPseudoLegalCheckEscapes(MoveList &escapes, int colour) {
+void Board::getPseudoLegalCheckEscapes(ScoredMoveList &escapes, int colour) {
     if (!isInCheck(colour)) {
         getAllPseudoLegalMoves(escapes, colour);
         return;
     }
     
-    MoveList allMoves;
-    getAllPseudoLegalMoves(allMoves, colour);
-    
-    escapes.clear();
-    for (unsigned int i = 0; i < allMoves.size(); i++) {
-        Move move = allMoves.get(i);
-        if (isLegalMove(move, colour)) {
-            escapes.add(move);
-        }
-    }
+    getAllLegalMove(escapes, colour);
 }
 
 uint64_t Board::getXRayPieceMap(int, int sq, int, 
@@ -673,11 +895,11 @@ uint64_t Board::getAttackMap(int colour, int sq) {
     uint64_t occupied = allPieces[WHITE] | allPieces[BLACK];
     
     uint64_t attacks = 0;
-    attacks |= getPawnAttacks(sq, 1 - colour) & pieces[colour][PAWNS];
-    attacks |= KNIGHTMOVES[sq] & pieces[colour][KNIGHTS];
-    attacks |= KINGMOVES[sq] & pieces[colour][KINGS];
-    attacks |= getRookAttacks(sq, occupied) & (pieces[colour][ROOKS] | pieces[colour][QUEENS]);
-    attacks |= getBishopAttacks(sq, occupied) & (pieces[colour][BISHOPS] | pieces[colour][QUEENS]);
+    attacks |= getPawnAttacks(sq, 1 - colour) & getPieces(colour, PAWNS);
+    attacks |= KNIGHTMOVES[sq] & getPieces(colour, KNIGHTS);
+    attacks |= KINGMOVES[sq] & getPieces(colour, KINGS);
+    attacks |= getRookAttacks(sq, occupied) & getRooksAndQueens(colour);
+    attacks |= getBishopAttacks(sq, occupied) & getBishopsAndQueens(colour);
     
     return attacks;
 }
@@ -686,14 +908,17 @@ uint64_t Board::getAttackMap(int sq) {
     return getAttackMap(WHITE, sq) | getAttackMap(BLACK, sq);
 }
 
+// Every square attacked by colour, computed set-wise for all its pieces
+uint64_t Board::getAttackedSquares(int colour, uint64_t occ) {
+    return pawnAttacks(getPieces(colour, PAWNS), colour)
+         | knightSetAttacks(getPieces(colour, KNIGHTS))
+         | sliderSetAttacks(getRooksAndQueens(colour), getBishopsAndQueens(colour), occ)
+         | KINGMOVES[getKingSq(colour)];
+}
+
 int Board::getPieceOnSquare(int colour, int sq) {
-    uint64_t sqBit = indexToBit(sq);
-    for (int piece = 0; piece < 6; piece++) {
-        if (pieces[colour][piece] & sqBit) {
-            return piece;
-        }
-    }
-    return -1;
+    int piece = mailbox[sq] - colour * 6;
+    return (piece >= 0 && piece < 6) ? piece : -1;
 }
 
 bool Board::isCheckMove(int colour, int sq) {
@@ -709,36 +934,196 @@ uint64_t Board::getBishopXRays(int sq, uint64_t occ, uint64_t blockers) {
     return getBishopAttacks(sq, occ ^ blockers);
 }
 
-bool Board::isDraw() {
-    if (fiftyMoveCounter >= 100) return true;
+int Board::see(Move m) {
+    if (isCastle(m)) return 0;
     
-    if (isInsufficientMaterial()) return true;
+    int startSq = getStartSq(m);
+    int endSq = getEndSq(m);
+    uint64_t startBit = indexToBit(startSq);
+    int colour = (allPieces[WHITE] & startBit) ? WHITE : BLACK;
     
-    if (!isInCheck(playerToMove)) {
-        MoveList legalMoves = getAllLegalMove(playerToMove);
-        if (legalMoves.size() == 0) return true;
+    int gain[32];
+    int d = 0;
+    int attacker = getPieceOnSquare(colour, startSq);
+    uint64_t occ = allPieces[WHITE] | allPieces[BLACK];
+    uint64_t diagonal = pieces[BISHOPS] | pieces[QUEENS];
+    uint64_t straight = pieces[ROOKS] | pieces[QUEENS];
+    
+    if (isEP(m)) {
+        gain[0] = SEE_VALUES[PAWNS];
+        occ ^= indexToBit(endSq + ((colour == WHITE) ? -8 : 8));
+    } else {
+        int victim = getPieceOnSquare(1 - colour, endSq);
+        gain[0] = (victim >= 0) ? SEE_VALUES[victim] : 0;
+    }
+    if (isPromotion(m)) {
+        attacker = getPromotion(m);
+        gain[0] += SEE_VALUES[attacker] - SEE_VALUES[PAWNS];
     }
     
+    uint64_t attackers = getAttackMap(endSq);
+    uint64_t fromBit = startBit;
+    int side = colour;
+    
+    while (d < 31) {
+        // Remove the capturer and uncover any slider standing behind it
+        uint64_t prevOcc = occ;
+        occ ^= fromBit;
+        if (attacker != KNIGHTS) {
+            attackers |= getBishopXRays(endSq, prevOcc, fromBit) & diagonal;
+            attackers |= getRookXRays(endSq, prevOcc, fromBit) & straight;
+        }
+        attackers &= occ;
+        
+        // Recapture with the least valuable attacker
+        side = 1 - side;
+        uint64_t sideAttackers = attackers & allPieces[side];
+        if (!sideAttackers) break;
+        
+        int nextAttacker = PAWNS;
+        while (!(sideAttackers & getPieces(side, nextAttacker)))
+            nextAttacker++;
+        
+        d++;
+        gain[d] = SEE_VALUES[attacker] - gain[d - 1];
+        attacker = nextAttacker;
+        fromBit = sideAttackers & getPieces(side, nextAttacker);
+        fromBit &= -fromBit;
+    }
+    
+    // Either side may stop capturing when continuing would lose material
+    for (; d > 0; d--)
+        gain[d - 1] = -std::max(-gain[d - 1], gain[d]);
+    return gain[0];
+}
+
+bool Board::seeGE(Move m, int threshold) {
+    if (isCastle(m)) return 0 >= threshold;
+    
+    int startSq = getStartSq(m);
+    int colour = (allPieces[WHITE] & indexToBit(startSq)) ? WHITE : BLACK;
+    int victim = isEP(m) ? PAWNS : getPieceOnSquare(1 - colour, getEndSq(m));
+    int attacker = isPromotion(m) ? getPromotion(m) : getPieceOnSquare(colour, startSq);
+    int bestCase = (victim >= 0) ? SEE_VALUES[victim] : 0;
+    if (isPromotion(m))
+        bestCase += SEE_VALUES[attacker] - SEE_VALUES[PAWNS];
+    
+    // The exchange can never gain more than the first capture, and never
+    // loses more than the piece we moved
+    if (bestCase < threshold) return false;
+    if (bestCase - SEE_VALUES[attacker] >= threshold) return true;
+    
+    return see(m) >= threshold;
+}
+
+bool Board::isReversibleMoveKey(uint64_t keyDiff) {
+    int i = cuckooH1(keyDiff);
+    if (cuckooKeys[i] != keyDiff) {
+        i = cuckooH2(keyDiff);
+        if (cuckooKeys[i] != keyDiff)
+            return false;
+    }
+    Move m = cuckooMoves[i];
+    return !(inBetween(getStartSq(m), getEndSq(m)) & getOccupancy());
+}
+
+// Stops at the first legal move. King steps are tried first, then pieces
+// which are not pinned, as any of their pseudo-legal moves is legal when not
+// in check. Only pinned pieces, en passant and check evasions need a move to
+// be made on a copy.
+bool Board::hasLegalMove(int colour) {
+    int kingSq = getKingSq(colour);
+    uint64_t occ = getOccupancy();
+    uint64_t friendly = allPieces[colour];
+    uint64_t enemy = allPieces[1 - colour];
+
+    // Castling needs the king to be able to step to the adjacent square, so
+    // it never adds a legal move to the king steps
+    // The king is taken off the board so it does not block a checking ray
+    uint64_t kingTargets = KINGMOVES[kingSq] & ~friendly;
+    if (kingTargets & ~getAttackedSquares(1 - colour, occ ^ indexToBit(kingSq)))
+        return true;
+
+    ScoredMove buffer[MAX_MOVES];
+    ScoredMoveList moves(buffer);
+    if (isInCheck(colour)) {
+        getAllPseudoLegalMoves(moves, colour);
+        for (unsigned int i = 0; i < moves.size(); i++) {
+            Move m = moves.get(i);
+            if (getStartSq(m) != kingSq && isLegalMove(m, colour))
+                return true;
+        }
+        return false;
+    }
+
+    uint64_t pinned = getPinnedMap(colour);
+    uint64_t bb = getPieces(colour, KNIGHTS) & ~pinned;
+    while (bb) {
+        if (KNIGHTMOVES[bitScanForward(bb)] & ~friendly)
+            return true;
+        bb &= bb - 1;
+    }
+    bb = getBishopsAndQueens(colour) & ~pinned;
+    while (bb) {
+        if (getBishopAttacks(bitScanForward(bb), occ) & ~friendly)
+            return true;
+        bb &= bb - 1;
+    }
+    bb = getRooksAndQueens(colour) & ~pinned;
+    while (bb) {
+        if (getRookAttacks(bitScanForward(bb), occ) & ~friendly)
+            return true;
+        bb &= bb - 1;
+    }
+
+    uint64_t pawns = getPieces(colour, PAWNS) & ~pinned;
+    uint64_t pushes = (colour == WHITE) ? (pawns << 8) & ~occ : (pawns >> 8) & ~occ;
+    uint64_t captures = (colour == WHITE)
+        ? ((pawns << 7) & NOTH) | ((pawns << 9) & NOTA)
+        : ((pawns >> 9) & NOTH) | ((pawns >> 7) & NOTA);
+    if (pushes || (captures & enemy))
+        return true;
+
+    getAllPseudoLegalMoves(moves, colour);
+    for (unsigned int i = 0; i < moves.size(); i++) {
+        Move m = moves.get(i);
+        if (((pinned & indexToBit(getStartSq(m))) || isEP(m)) && isLegalMove(m, colour))
+            return true;
+    }
     return false;
 }
 
+// Draws that do not depend on the moves available. Stalemate is separate
+// since search finds it for free when it has no legal move to play.
+bool Board::isDraw() {
+    // Checkmate takes precedence over the fifty-move rule
+    if (fiftyMoveCounter >= 100
+     && (!isInCheck(playerToMove) || hasLegalMove(playerToMove)))
+        return true;
+    return isInsufficientMaterial();
+}
+
+bool Board::isStalemate() {
+    return !isInCheck(playerToMove) && !hasLegalMove(playerToMove);
+}
+
 bool Board::isInsufficientMaterial() {
     if (count(allPieces[WHITE]) == 1 && count(allPieces[BLACK]) == 1) return true;
     
     for (int color = 0; color < 2; color++) {
         int opponent = 1 - color;
         if (count(allPieces[color]) == 1 && count(allPieces[opponent]) == 2) {
-            if (pieces[opponent][KNIGHTS] || pieces[opponent][BISHOPS]) {
+            if (getPieces(opponent, KNIGHTS) || getPieces(opponent, BISHOPS)) {
                 return true;
             }
         }
     }
     
     if (count(allPieces[WHITE]) == 2 && count(allPieces[BLACK]) == 2 &&
-        pieces[WHITE][BISHOPS] && pieces[BLACK][BISHOPS]) {
+        getPieces(WHITE, BISHOPS) && getPieces(BLACK, BISHOPS)) {
         
-        bool whiteLightSquare = (pieces[WHITE][BISHOPS] & LIGHT) != 0;
-        bool blackLightSquare = (pieces[BLACK][BISHOPS] & LIGHT) != 0;
+        bool whiteLightSquare = (getPieces(WHITE, BISHOPS) & LIGHT) != 0;
+        bool blackLightSquare = (getPieces(BLACK, BISHOPS) & LIGHT) != 0;
         
         if (whiteLightSquare == blackLightSquare) return true;
     }
@@ -747,7 +1132,7 @@ bool Board::isInsufficientMaterial() {
 }
 
 void Board::getCheckMaps(int colour, uint64_t *checkMaps) {
-    uint64_t kingBB = pieces[colour][KINGS];
+    uint64_t kingBB = getPieces(colour, KINGS);
     if (!kingBB) return;
     
     int kingSq = bitScanForward(kingBB);
@@ -762,9 +1147,5 @@ void Board::getCheckMaps(int colour, uint64_t *checkMaps) {
 }
 
 int Board::getMaterial(int colour) {
-    return count(pieces[colour][PAWNS]) * 100 +
-           count(pieces[colour][KNIGHTS]) * 320 +
-           count(pieces[colour][BISHOPS]) * 330 +
-           count(pieces[colour][ROOKS]) * 500 +
-           count(pieces[colour][QUEENS]) * 900;
+    return material[colour];
 }
\ No newline at end of file
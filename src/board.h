@@ -3,8 +3,6 @@
 
 #include "common.h"
 
-extern uint64_t inBetweenSqs[64][64];
-
 const uint8_t WHITEKSIDE = 0x1;
 const uint8_t WHITEQSIDE = 0x2;
 const uint8_t BLACKKSIDE = 0x4;
@@ -14,6 +12,18 @@ const uint8_t BLACKCASTLE = 0xC;
 
 const uint16_t NO_EP_POSSIBLE = 0x8;
 
+const int NO_SQUARE = 64;
+
+// Piece changes made by the last doMove, for incremental evaluators. Pieces
+// are indexed colour * 6 + piece type; from is NO_SQUARE for an added piece
+// and to is NO_SQUARE for a removed one.
+struct DirtyPiece {
+    int8_t count;
+    int8_t piece[3];
+    int8_t from[3];
+    int8_t to[3];
+};
+
 const bool MOVEGEN_CAPTURES = true;
 const bool MOVEGEN_QUIETS = false;
 
@@ -74,60 +84,101 @@ public:
     void undoNullMove(uint16_t _epCaptureFile);
 
     PieceMoveList getPieceMoveList(int colour);
-    MoveList getAllLegalMove(int colour);
-    void getAllPseudoLegalMoves(MoveList &legalMoves, int colour);
-    void getPseudoLegalQuiets(MoveList &quiets, int colour);
-    void getPseudoLegalCaptures(MoveList &captures, int colour, bool includePromotions);
-    void getPseudoLegalPromotions(MoveList &moves, int colour);
-    void getPseudoLegalChecks(MoveList &checks, int colour);
-    void getPseudoLegalCheckEscapes(MoveList &escapes, int colour);
+    void getAllLegalMove(ScoredMoveList &legal, int colour);
+    void getAllPseudoLegalMoves(ScoredMoveList &legalMoves, int colour);
+    void getPseudoLegalQuiets(ScoredMoveList &quiets, int colour);
+    void getPseudoLegalCaptures(ScoredMoveList &captures, int colour, bool includePromotions);
+    void getPseudoLegalPromotions(ScoredMoveList &moves, int colour);
+    void getPseudoLegalChecks(ScoredMoveList &checks, int colour);
+    void getPseudoLegalCheckEscapes(ScoredMoveList &escapes, int colour);
 
     uint64_t getXRayPieceMap(int colour, int sq, int blockerColour,
             uint64_t blockerStart, uint64_t blockerEnd);
     uint64_t getAttackMap(int colour, int sq);
     uint64_t getAttackMap(int sq);
+    uint64_t getAttackedSquares(int colour, uint64_t occ);
     int getPieceOnSquare(int colour, int sq);
     bool isCheckMove(int colour, int sq);
     uint64_t getRookXRays(int sq, uint64_t occ, uint64_t blockers);
     uint64_t getBishopXRays(int sq, uint64_t occ, uint64_t blockers);
     uint64_t getPinnedMap(int colour);
+    int see(Move m);
+    bool seeGE(Move m, int threshold);
 
     bool isInCheck(int colour);
+    bool isSquareAttacked(int sq, int byColour);
+    bool isSquareAttacked(int sq, int byColour, uint64_t occ);
+    bool hasLegalMove(int colour);
     bool isDraw();
+    bool isStalemate();
+    // Whether keyDiff is the zobrist change made by a reversible move which
+    // is not blocked in this position
+    bool isReversibleMoveKey(uint64_t keyDiff);
     bool isInsufficientMaterial();
     void getCheckMaps(int colour, uint64_t *checkMaps);
 
+    uint64_t getPawnAttacks(int sq, int colour);
+    uint64_t getRookAttacks(int sq, uint64_t occ);
+    uint64_t getBishopAttacks(int sq, uint64_t occ);
+
     int getMaterial(int colour);
+    Score getPsqtScore() const { return psqtScore; }
+    uint64_t getPieces(int colour, int piece) const { return pieces[piece] & allPieces[colour]; }
+    uint64_t getPieces(int piece) const { return pieces[piece]; }
+    uint64_t getAllPieces(int colour) const { return allPieces[colour]; }
+    uint64_t getOccupancy() const { return allPieces[WHITE] | allPieces[BLACK]; }
+    uint64_t getRooksAndQueens(int colour) const { return (pieces[ROOKS] | pieces[QUEENS]) & allPieces[colour]; }
+    uint64_t getBishopsAndQueens(int colour) const { return (pieces[BISHOPS] | pieces[QUEENS]) & allPieces[colour]; }
+    int getKingSq(int colour) const { return bitScanForward(pieces[KINGS] & allPieces[colour]); }
     int getPlayerToMove() const { return playerToMove; }
+    int getFiftyMoveCounter() const { return fiftyMoveCounter; }
+    int getMoveNumber() const { return moveNumber; }
+    int getCastlingRights() const { return castlingRights; }
+    uint16_t getEPCaptureFile() const { return epCaptureFile; }
+    uint64_t getZobristKey() const { return zobristKey; }
+    uint64_t calculateZobristKey();
+    uint64_t getPawnKey() const { return pawnKey; }
+    const DirtyPiece &getDirtyPiece() const { return dirty; }
 
 private:
-    uint64_t pieces[2][6];
-    uint64_t allPieces[2]; 
-    uint8_t castlingRights;
-    uint16_t epCaptureFile;
-    int fiftyMoveCounter;
-    int moveNumber;
-    int playerToMove;
+    // Bitboards by piece type and by colour, so a colour's pieces of one
+    // type are a single AND. The mailbox holds colour * 6 + piece type, or
+    // -1 on an empty square.
+    uint64_t pieces[6];
+    uint64_t allPieces[2];
     uint64_t zobristKey;
+    uint64_t pawnKey;
+    Score psqtScore;
+    int16_t material[2];
+    uint16_t moveNumber;
+    uint8_t fiftyMoveCounter;
+    uint8_t castlingRights;
+    uint8_t epCaptureFile;
+    uint8_t playerToMove;
+    int8_t mailbox[64];
+    DirtyPiece dirty;
     
-    uint64_t calculateZobristKey();
-    bool isSquareAttacked(int sq, int byColour);
-    uint64_t getPawnAttacks(int sq, int colour);
-    uint64_t getRookAttacks(int sq, uint64_t occ);
-    uint64_t getBishopAttacks(int sq, uint64_t occ);
+    uint64_t calculatePawnKey();
+    void calculateMailbox();
+    
+    void addPiece(int colour, int piece, int sq);
+    void removePiece(int colour, int piece, int sq);
+    void movePiece(int colour, int piece, int startSq, int endSq);
+    void recordDirty(int piece, int from, int to);
+    void calculateIncrementalState();
     
-    void generatePawnMoves(MoveList &moves, int colour, uint64_t occupied, uint64_t enemy);
-    void generatePawnCaptures(MoveList &moves, uint64_t captures, int colour, int fromOffset, int promoRank);
-    void generateEnPassantMoves(MoveList &moves, int colour);
-    void generateKnightMoves(MoveList &moves, int colour, uint64_t friendly);
-    void generateBishopMoves(MoveList &moves, int colour, uint64_t occupied, uint64_t friendly);
-    void generateRookMoves(MoveList &moves, int colour, uint64_t occupied, uint64_t friendly);
-    void generateQueenMoves(MoveList &moves, int colour, uint64_t occupied, uint64_t friendly);
-    void generateKingMoves(MoveList &moves, int colour, uint64_t occupied, uint64_t friendly);
-    void generateCastlingMoves(MoveList &moves, int colour);
+    void generatePawnMoves(ScoredMoveList &moves, int colour, uint64_t occupied, uint64_t enemy);
+    void generatePawnCaptures(ScoredMoveList &moves, uint64_t captures, int colour, int fromOffset, int promoRank);
+    void generateEnPassantMoves(ScoredMoveList &moves, int colour);
+    void generateKnightMoves(ScoredMoveList &moves, int colour, uint64_t friendly);
+    void generateBishopMoves(ScoredMoveList &moves, int colour, uint64_t occupied, uint64_t friendly);
+    void generateRookMoves(ScoredMoveList &moves, int colour, uint64_t occupied, uint64_t friendly);
+    void generateQueenMoves(ScoredMoveList &moves, int colour, uint64_t occupied, uint64_t friendly);
+    void generateKingMoves(ScoredMoveList &moves, int colour, uint64_t occupied, uint64_t friendly);
+    void generateCastlingMoves(ScoredMoveList &moves, int colour);
     
     template<int PieceType>
-    void generatePieceMoves(MoveList &moves, int colour, uint64_t occupied, uint64_t friendly);
+    void generatePieceMoves(ScoredMoveList &moves, int colour, uint64_t occupied, uint64_t friendly);
     
     bool canCastle(int colour, bool kingside);
     bool isLegalMove(Move move, int colour);
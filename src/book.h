@@ -0,0 +1,20 @@
+#ifndef __BOOK_H__
+#define __BOOK_H__
+
+#include "board.h"
+#include <string>
+
+// Polyglot hash of a position. This uses Polyglot's own random numbers and
+// is unrelated to the engine's zobrist key.
+uint64_t polyglotKey(const Board &b);
+
+// Memory maps a Polyglot .bin book, replacing any book already open. An
+// empty path just closes the current book.
+bool openBook(const std::string &path);
+bool isBookLoaded();
+
+// Returns NULL_MOVE if the position is not in the book. Moves are chosen at
+// random in proportion to their weights unless bestOnly is set.
+Move probeBook(Board &b, bool bestOnly);
+
+#endif
@@ -1,4 +1,5 @@
 #include "common.h"
+#include <sstream>
 
 const int index64[64] = {
     0,  47,  1, 56, 48, 27,  2, 60,
@@ -56,7 +57,7 @@ uint64_t flipAcrossRanks(uint64_t bb) {
         return bb;
     #else
         bb = ((bb >> 8) & 0x00FF00FF00FF00FF) | ((bb & 0x00FF00FF00FF00FF) << 8);
-        bb = ((bb >> 16) & 0x00FF00FF00FF00FF) | ((bb & 0x00FF00FF00FF00FF) << 16);
+        bb = ((bb >> 16) & 0x0000FFFF0000FFFF) | ((bb & 0x0000FFFF0000FFFF) << 16);
         bb = (bb >> 32) | (bb << 32);
         return bb;
     #endif
@@ -66,6 +67,29 @@ uint64_t indexToBit(int sq) {
     return 1ull << sq;
 }
 
+template <typename T>
+static bool parseWhole(const std::string &text, T &value) {
+    std::istringstream in(text);
+    T parsed;
+    if (!(in >> parsed) || !(in >> std::ws).eof())
+        return false;
+    value = parsed;
+    return true;
+}
+
+bool parseNumber(const std::string &text, int &value) {
+    return parseWhole(text, value);
+}
+
+// Streams wrap negative numbers around rather than failing
+bool parseNumber(const std::string &text, uint64_t &value) {
+    return text.find('-') == std::string::npos && parseWhole(text, value);
+}
+
+bool parseNumber(const std::string &text, double &value) {
+    return parseWhole(text, value);
+}
+
 uint64_t getTimeElapsed(ChessTime startTime) {
     auto endTime = ChessClock::now();
     auto timeSpan = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime);
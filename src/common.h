@@ -18,6 +18,10 @@ const int ROOKS = 3;
 const int QUEENS = 4;
 const int KINGS = 5;
 
+// Plain piece values for the material count, SEE and capture ordering. The
+// evaluation has its own tuned values.
+const int MATERIAL_VALUES[6] = {100, 320, 330, 500, 900, 0};
+
 const int MATE_SCORE = 32766;
 const int INFTY = 32767;
 const int MAX_DEPTH = 127;
@@ -33,10 +37,35 @@ int count(u64 bb);
 u64 flipAcrossRanks(u64 bb);
 u64 indexToBit(int sq);
 
+// Reads a whole command line argument as a number. Returns false, leaving
+// value alone, if there is anything else in it.
+bool parseNumber(const std::string &text, int &value);
+bool parseNumber(const std::string &text, uint64_t &value);
+bool parseNumber(const std::string &text, double &value);
+
 inline int relativeRank(int c, int r) {
     return (r ^ (7 * c));
 }
 
+// Midgame and endgame scores packed into one int so that both halves are
+// accumulated with a single add (SWAR). The endgame half lives in the upper
+// 16 bits; decEvalEg rounds so that a negative midgame half borrows correctly.
+typedef int Score;
+
+const Score SCORE_ZERO = 0;
+
+inline Score E(int mg, int eg) {
+    return (Score) ((unsigned int) eg << 16) + mg;
+}
+
+inline int decEvalMg(Score s) {
+    return (int) (int16_t) (uint16_t) (unsigned int) s;
+}
+
+inline int decEvalEg(Score s) {
+    return (int) (int16_t) (uint16_t) ((unsigned int) (s + 0x8000) >> 16);
+}
+
 typedef uint16_t Move;
 
 const Move NULL_MOVE = 0;
@@ -153,4 +182,82 @@ public:
 typedef SearchArrayList<Move> MoveList;
 typedef SearchArrayList<int> ScoreList;
 
+// A move with its ordering score in the upper 16 bits, so comparing two
+// entries as integers compares their scores
+typedef int32_t ScoredMove;
+
+inline ScoredMove makeScoredMove(Move m, int score) {
+    return (ScoredMove) (((uint32_t) score << 16) | m);
+}
+
+inline Move getMove(ScoredMove sm) {
+    return (Move) (sm & 0xFFFF);
+}
+
+inline int getMoveScore(ScoredMove sm) {
+    return sm >> 16;
+}
+
+// Moves generated in place into a buffer owned by the caller, normally a
+// local array of MAX_MOVES entries, so that no list is ever copied
+class ScoredMoveList {
+public:
+    explicit ScoredMoveList(ScoredMove *buffer) {
+        entries = buffer;
+        length = 0;
+    }
+
+    unsigned int size() const {
+        return length;
+    }
+
+    void add(Move m) {
+        entries[length++] = m;
+    }
+
+    Move get(int i) const {
+        return getMove(entries[i]);
+    }
+
+    int getScore(int i) const {
+        return getMoveScore(entries[i]);
+    }
+
+    void setScore(int i, int score) {
+        entries[i] = makeScoredMove(getMove(entries[i]), score);
+    }
+
+    void swap(int i, int j) {
+        ScoredMove temp = entries[i];
+        entries[i] = entries[j];
+        entries[j] = temp;
+    }
+
+    void resize(int l) {
+        length = l;
+    }
+
+    void clear() {
+        length = 0;
+    }
+
+    // One selection sort step: brings the best scored entry from i onwards
+    // to i. Cheaper than sorting up front when a cutoff comes early.
+    Move pickBest(unsigned int i) {
+        unsigned int best = i;
+        for (unsigned int j = i + 1; j < length; j++)
+            if (entries[j] > entries[best])
+                best = j;
+        swap(i, best);
+        return getMove(entries[i]);
+    }
+
+private:
+    ScoredMove *entries;
+    unsigned int length;
+
+    ScoredMoveList(const ScoredMoveList &other);
+    ScoredMoveList &operator=(const ScoredMoveList &other);
+};
+
 #endif
@@ -0,0 +1,287 @@
+#include "datagen.h"
+#include "packed.h"
+#include "search.h"
+#include "uci.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A side is adjudicated the winner once every search for WIN_ADJUDICATION_PLIES
+// plies in a row agrees it is this far ahead
+const int WIN_ADJUDICATION_SCORE = 1000;
+const int WIN_ADJUDICATION_PLIES = 6;
+// Drawn once the score stays this close to zero past DRAW_ADJUDICATION_START
+const int DRAW_ADJUDICATION_SCORE = 10;
+const int DRAW_ADJUDICATION_PLIES = 12;
+const int DRAW_ADJUDICATION_START = 80;
+const int MAX_GAME_PLIES = 400;
+const int DATAGEN_REPORT_GAMES = 100;
+
+struct DatagenOptions {
+    std::string output;
+    uint64_t games;
+    int threads;
+    uint64_t nodes;
+    int randomPlies;
+    uint64_t seed;
+};
+
+// A finished game, handed from a worker to the writer thread as text lines
+// or as packed positions
+struct DatagenGame {
+    uint64_t index;
+    std::string lines;
+    std::vector<PackedPosition> positions;
+};
+
+struct DatagenQueue {
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<DatagenGame> games;
+    int workers;
+    SearchStats stats;
+};
+
+static bool parseOptions(int argc, char **argv, DatagenOptions &options) {
+    options.games = DEFAULT_DATAGEN_GAMES;
+    options.threads = std::max(1, (int) std::thread::hardware_concurrency());
+    options.nodes = DEFAULT_DATAGEN_NODES;
+    options.randomPlies = DEFAULT_DATAGEN_RANDOM_PLIES;
+    options.seed = 0;
+    bool valid = true;
+    for (int i = 0; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        std::string value = argv[i + 1];
+        if (option == "--output") options.output = value;
+        else if (option == "--games") valid &= parseNumber(value, options.games);
+        else if (option == "--threads") valid &= parseNumber(value, options.threads);
+        else if (option == "--nodes") valid &= parseNumber(value, options.nodes);
+        else if (option == "--random-plies") valid &= parseNumber(value, options.randomPlies);
+        else if (option == "--seed") valid &= parseNumber(value, options.seed);
+        else {
+            std::cout << "Unknown option " << option << std::endl;
+            return false;
+        }
+    }
+    options.threads = std::max(1, options.threads);
+    options.nodes = std::max((uint64_t) 1, options.nodes);
+    options.randomPlies = std::max(0, options.randomPlies);
+    if (!valid || argc % 2 != 0 || options.output.empty()) {
+        std::cout << "Usage: brahma datagen --output FILE [--games N] [--threads N]"
+                  << " [--nodes N] [--random-plies N] [--seed N]" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static bool isThreefold(Board &b, const std::vector<uint64_t> &keys) {
+    int reversible = std::min((int) keys.size(), b.getFiftyMoveCounter());
+    int repeats = 0;
+    for (int i = 1; i <= reversible; i++) {
+        if (keys[keys.size() - i] == b.getZobristKey())
+            repeats++;
+    }
+    return repeats >= 2;
+}
+
+// Random legal moves from the start position, retried until they leave a
+// game that is still going
+static Board randomOpening(std::mt19937_64 &rng, int randomPlies, std::vector<uint64_t> &keys) {
+    while (true) {
+        Board b;
+        keys.clear();
+        // Either side can be first to move out of the book
+        int plies = randomPlies + (int) (rng() & 1);
+        int ply = 0;
+        for (; ply < plies; ply++) {
+            ScoredMove buffer[MAX_MOVES];
+            ScoredMoveList moves(buffer);
+            b.getAllLegalMove(moves, b.getPlayerToMove());
+            if (moves.size() == 0)
+                break;
+            keys.push_back(b.getZobristKey());
+            b.doMove(moves.get((int) (rng() % moves.size())), b.getPlayerToMove());
+        }
+        if (ply == plies && b.hasLegalMove(b.getPlayerToMove()) && !b.isDraw())
+            return b;
+    }
+}
+
+// Plays one game and returns its labelled positions. Each game is seeded by
+// its index and starts from cleared caches, so the output does not depend
+// on which thread played it.
+static void playGame(Searcher &searcher, const DatagenOptions &options, uint64_t game,
+        std::vector<PackedPosition> &positions) {
+    std::mt19937_64 rng(options.seed * 0x9E3779B97F4A7C15ULL + game);
+    std::vector<uint64_t> keys;
+    Board b = randomOpening(rng, options.randomPlies, keys);
+    searcher.clearCaches();
+    SearchLimits limits;
+    limits.nodes = options.nodes;
+
+    // White's score in half points
+    int result = 1;
+    int whiteWinPlies = 0, blackWinPlies = 0, drawPlies = 0;
+    for (int ply = 0; ply < MAX_GAME_PLIES; ply++) {
+        int colour = b.getPlayerToMove();
+        if (!b.hasLegalMove(colour)) {
+            if (b.isInCheck(colour))
+                result = (colour == WHITE) ? 0 : 2;
+            break;
+        }
+        if (b.isDraw() || isThreefold(b, keys))
+            break;
+
+        searcher.clearStop();
+        searcher.setGameHistory(keys);
+        Move m = searcher.getBestMove(b, limits);
+        int score = (colour == WHITE) ? searcher.getScore() : -searcher.getScore();
+
+        // Checks, captures and mates are left out as their static evaluation
+        // says little about the score
+        if (!b.isInCheck(colour) && !isCapture(m) && !isPromotion(m)
+         && std::abs(score) < MATE_SCORE - MAX_DEPTH)
+            positions.push_back(packPosition(b, score, 0));
+
+        whiteWinPlies = (score >= WIN_ADJUDICATION_SCORE) ? whiteWinPlies + 1 : 0;
+        blackWinPlies = (score <= -WIN_ADJUDICATION_SCORE) ? blackWinPlies + 1 : 0;
+        drawPlies = (ply >= DRAW_ADJUDICATION_START && std::abs(score) <= DRAW_ADJUDICATION_SCORE)
+                  ? drawPlies + 1 : 0;
+        if (whiteWinPlies >= WIN_ADJUDICATION_PLIES) {
+            result = 2;
+            break;
+        }
+        if (blackWinPlies >= WIN_ADJUDICATION_PLIES) {
+            result = 0;
+            break;
+        }
+        if (drawPlies >= DRAW_ADJUDICATION_PLIES)
+            break;
+
+        keys.push_back(b.getZobristKey());
+        b.doMove(m, colour);
+    }
+
+    for (PackedPosition &p : positions)
+        p.result = (uint8_t) result;
+}
+
+static void appendLines(const std::vector<PackedPosition> &positions, std::string &lines) {
+    const char *RESULTS[3] = {"0.0", "0.5", "1.0"};
+    for (const PackedPosition &p : positions) {
+        Board b;
+        unpackPosition(p, b);
+        lines += boardToFen(b) + " [" + RESULTS[p.result] + "] " + std::to_string(p.score) + "\n";
+    }
+}
+
+static void runWorker(const DatagenOptions &options, std::atomic<uint64_t> &nextGame, DatagenQueue &queue) {
+    Searcher searcher;
+    searcher.setPrintInfo(false);
+    for (uint64_t game = nextGame++; game < options.games; game = nextGame++) {
+        DatagenGame finished;
+        finished.index = game;
+        playGame(searcher, options, game, finished.positions);
+        if (!isPackedFile(options.output))
+            appendLines(finished.positions, finished.lines);
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.games.push_back(std::move(finished));
+        queue.ready.notify_one();
+    }
+
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.stats += searcher.getStats();
+    queue.workers--;
+    queue.ready.notify_one();
+}
+
+// Writes to the text file when it is open and to the packed writer otherwise.
+// Games finishing early are held back until every earlier game is written,
+// so the file is in game order whatever the thread count.
+static void runWriter(std::ofstream &text, PackedWriter &packed, DatagenQueue &queue) {
+    ChessTime startTime = ChessClock::now();
+    uint64_t games = 0, positions = 0;
+    std::map<uint64_t, DatagenGame> finished;
+    while (true) {
+        std::unique_lock<std::mutex> lock(queue.mutex);
+        queue.ready.wait(lock, [&]() { return !queue.games.empty() || queue.workers == 0; });
+        if (queue.games.empty())
+            break;
+        DatagenGame next = std::move(queue.games.front());
+        queue.games.pop_front();
+        lock.unlock();
+
+        uint64_t index = next.index;
+        finished[index] = std::move(next);
+        for (auto it = finished.find(games); it != finished.end(); it = finished.find(games)) {
+            const DatagenGame &game = it->second;
+            if (text.is_open())
+                text << game.lines;
+            else
+                for (const PackedPosition &p : game.positions)
+                    packed.write(p);
+            games++;
+            positions += game.positions.size();
+            finished.erase(it);
+            if (games % DATAGEN_REPORT_GAMES == 0) {
+                uint64_t elapsed = getTimeElapsed(startTime);
+                std::printf("games %llu positions %llu pos/s %llu\n", (unsigned long long) games,
+                    (unsigned long long) positions, (unsigned long long) (positions * 1000 / (elapsed ? elapsed : 1)));
+                std::fflush(stdout);
+            }
+        }
+    }
+
+    uint64_t elapsed = getTimeElapsed(startTime);
+    std::printf("games %llu positions %llu pos/s %llu time %llus\n", (unsigned long long) games,
+        (unsigned long long) positions, (unsigned long long) (positions * 1000 / (elapsed ? elapsed : 1)),
+        (unsigned long long) elapsed / 1000);
+}
+
+int runDatagen(int argc, char **argv) {
+    DatagenOptions options;
+    if (!parseOptions(argc, argv, options))
+        return 1;
+    std::ofstream text;
+    PackedWriter packed;
+    bool opened;
+    if (isPackedFile(options.output)) {
+        opened = packed.open(options.output);
+    } else {
+        text.open(options.output, std::ios::app);
+        opened = text.is_open();
+    }
+    if (!opened) {
+        std::cout << "Cannot open " << options.output << std::endl;
+        return 1;
+    }
+
+    DatagenQueue queue;
+    queue.workers = options.threads;
+    std::atomic<uint64_t> nextGame(0);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < options.threads; t++)
+        workers.push_back(std::thread(runWorker, std::cref(options), std::ref(nextGame), std::ref(queue)));
+    std::thread writer(runWriter, std::ref(text), std::ref(packed), std::ref(queue));
+
+    for (std::thread &worker : workers)
+        worker.join();
+    writer.join();
+#ifdef STATS
+    queue.stats.print();
+#endif
+
+    bool written = text.is_open() ? (bool) text.flush() : packed.close();
+    if (!written)
+        std::cout << "Error writing " << options.output << std::endl;
+    return written ? 0 : 1;
+}
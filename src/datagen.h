@@ -0,0 +1,20 @@
+#ifndef __DATAGEN_H__
+#define __DATAGEN_H__
+
+const int DEFAULT_DATAGEN_GAMES = 1000;
+const int DEFAULT_DATAGEN_NODES = 5000;
+const int DEFAULT_DATAGEN_RANDOM_PLIES = 8;
+
+// Self-play games at a fixed node count, played concurrently with a
+// searcher per thread. Quiet positions are written one per line as
+// "FEN [result] score", with the result and score from white's point of
+// view, which brahma tune reads directly. Options:
+//   --output FILE       file to append positions to, packed if named *.packed
+//   --games N           games to play
+//   --threads N         worker threads, all cores by default
+//   --nodes N           nodes searched per move
+//   --random-plies N    random moves played from the start position
+//   --seed N            seed for the random openings
+int runDatagen(int argc, char **argv);
+
+#endif
@@ -0,0 +1,644 @@
+#include "eval.h"
+#include "bbinit.h"
+#include <algorithm>
+#include <cstdlib>
+
+Score pieceSquareTable[2][6][64];
+
+// Piece-square tables from white's point of view, rank 8 first so that they
+// read like a board diagram. Black squares are mirrored with sq ^ 56.
+const int PSQT_MG[6][64] = {
+{ // Pawns
+   0,   0,   0,   0,   0,   0,   0,   0,
+  50,  50,  50,  50,  50,  50,  50,  50,
+  10,  10,  20,  30,  30,  20,  10,  10,
+   5,   5,  10,  25,  25,  10,   5,   5,
+   0,   0,   0,  20,  20,   0,   0,   0,
+   5,  -5, -10,   0,   0, -10,  -5,   5,
+   5,  10,  10, -20, -20,  10,  10,   5,
+   0,   0,   0,   0,   0,   0,   0,   0
+},
+{ // Knights
+ -50, -40, -30, -30, -30, -30, -40, -50,
+ -40, -20,   0,   0,   0,   0, -20, -40,
+ -30,   0,  10,  15,  15,  10,   0, -30,
+ -30,   5,  15,  20,  20,  15,   5, -30,
+ -30,   0,  15,  20,  20,  15,   0, -30,
+ -30,   5,  10,  15,  15,  10,   5, -30,
+ -40, -20,   0,   5,   5,   0, -20, -40,
+ -50, -40, -30, -30, -30, -30, -40, -50
+},
+{ // Bishops
+ -20, -10, -10, -10, -10, -10, -10, -20,
+ -10,   0,   0,   0,   0,   0,   0, -10,
+ -10,   0,   5,  10,  10,   5,   0, -10,
+ -10,   5,   5,  10,  10,   5,   5, -10,
+ -10,   0,  10,  10,  10,  10,   0, -10,
+ -10,  10,  10,  10,  10,  10,  10, -10,
+ -10,   5,   0,   0,   0,   0,   5, -10,
+ -20, -10, -10, -10, -10, -10, -10, -20
+},
+{ // Rooks
+   0,   0,   0,   0,   0,   0,   0,   0,
+   5,  10,  10,  10,  10,  10,  10,   5,
+  -5,   0,   0,   0,   0,   0,   0,  -5,
+  -5,   0,   0,   0,   0,   0,   0,  -5,
+  -5,   0,   0,   0,   0,   0,   0,  -5,
+  -5,   0,   0,   0,   0,   0,   0,  -5,
+  -5,   0,   0,   0,   0,   0,   0,  -5,
+   0,   0,   0,   5,   5,   0,   0,   0
+},
+{ // Queens
+ -20, -10, -10,  -5,  -5, -10, -10, -20,
+ -10,   0,   0,   0,   0,   0,   0, -10,
+ -10,   0,   5,   5,   5,   5,   0, -10,
+  -5,   0,   5,   5,   5,   5,   0,  -5,
+   0,   0,   5,   5,   5,   5,   0,  -5,
+ -10,   5,   5,   5,   5,   5,   0, -10,
+ -10,   0,   5,   0,   0,   0,   0, -10,
+ -20, -10, -10,  -5,  -5, -10, -10, -20
+},
+{ // Kings
+ -30, -40, -40, -50, -50, -40, -40, -30,
+ -30, -40, -40, -50, -50, -40, -40, -30,
+ -30, -40, -40, -50, -50, -40, -40, -30,
+ -30, -40, -40, -50, -50, -40, -40, -30,
+ -20, -30, -30, -40, -40, -30, -30, -20,
+ -10, -20, -20, -20, -20, -20, -20, -10,
+  20,  20,   0,   0,   0,   0,  20,  20,
+  20,  30,  10,   0,   0,  10,  30,  20
+}
+};
+
+const int PSQT_EG[6][64] = {
+{ // Pawns
+   0,   0,   0,   0,   0,   0,   0,   0,
+  80,  80,  80,  80,  80,  80,  80,  80,
+  50,  50,  45,  40,  40,  45,  50,  50,
+  30,  25,  20,  15,  15,  20,  25,  30,
+  15,  10,   5,   0,   0,   5,  10,  15,
+   5,   5,   0,   0,   0,   0,   5,   5,
+   5,   5,   5,   5,   5,   5,   5,   5,
+   0,   0,   0,   0,   0,   0,   0,   0
+},
+{ // Knights
+ -50, -35, -25, -20, -20, -25, -35, -50,
+ -35, -20, -10,  -5,  -5, -10, -20, -35,
+ -25, -10,   5,  10,  10,   5, -10, -25,
+ -20,  -5,  10,  20,  20,  10,  -5, -20,
+ -20,  -5,  10,  20,  20,  10,  -5, -20,
+ -25, -10,   5,  10,  10,   5, -10, -25,
+ -35, -20, -10,  -5,  -5, -10, -20, -35,
+ -50, -35, -25, -20, -20, -25, -35, -50
+},
+{ // Bishops
+ -15, -10,  -8,  -5,  -5,  -8, -10, -15,
+ -10,  -5,   0,   2,   2,   0,  -5, -10,
+  -8,   0,   5,   8,   8,   5,   0,  -8,
+  -5,   2,   8,  12,  12,   8,   2,  -5,
+  -5,   2,   8,  12,  12,   8,   2,  -5,
+  -8,   0,   5,   8,   8,   5,   0,  -8,
+ -10,  -5,   0,   2,   2,   0,  -5, -10,
+ -15, -10,  -8,  -5,  -5,  -8, -10, -15
+},
+{ // Rooks
+  10,  10,  10,  10,  10,  10,  10,  10,
+  15,  15,  15,  15,  15,  15,  15,  15,
+   5,   5,   5,   5,   5,   5,   5,   5,
+   0,   0,   0,   0,   0,   0,   0,   0,
+   0,   0,   0,   0,   0,   0,   0,   0,
+  -5,  -5,  -5,  -5,  -5,  -5,  -5,  -5,
+  -5,  -5,  -5,  -5,  -5,  -5,  -5,  -5,
+ -10,  -5,   0,   0,   0,   0,  -5, -10
+},
+{ // Queens
+ -20, -10, -10,  -5,  -5, -10, -10, -20,
+ -10,   0,   5,   5,   5,   5,   0, -10,
+ -10,   5,  10,  10,  10,  10,   5, -10,
+  -5,   5,  10,  15,  15,  10,   5,  -5,
+  -5,   5,  10,  15,  15,  10,   5,  -5,
+ -10,   0,  10,  10,  10,  10,   0, -10,
+ -10,   0,   0,   0,   0,   0,   0, -10,
+ -20, -10, -10,  -5,  -5, -10, -10, -20
+},
+{ // Kings
+ -50, -40, -30, -20, -20, -30, -40, -50,
+ -30, -20, -10,   0,   0, -10, -20, -30,
+ -30, -10,  20,  30,  30,  20, -10, -30,
+ -30, -10,  30,  40,  40,  30, -10, -30,
+ -30, -10,  30,  40,  40,  30, -10, -30,
+ -30, -10,  20,  30,  30,  20, -10, -30,
+ -30, -30,   0,   0,   0,   0, -30, -30,
+ -50, -30, -30, -30, -30, -30, -30, -50
+}
+};
+
+const Score KNIGHT_MOBILITY[9] = {
+    E(-38, -48), E(-25, -32), E(-8, -18), E(-2, -8), E(3, 2),
+    E(8, 7), E(13, 10), E(17, 12), E(21, 14)
+};
+
+const Score BISHOP_MOBILITY[14] = {
+    E(-30, -36), E(-12, -14), E(6, -2), E(13, 7), E(19, 14), E(25, 22), E(28, 28),
+    E(31, 31), E(33, 35), E(35, 38), E(39, 40), E(41, 43), E(45, 44), E(48, 47)
+};
+
+const Score ROOK_MOBILITY[15] = {
+    E(-30, -40), E(-14, -10), E(-8, 12), E(-5, 26), E(-3, 34), E(-1, 41), E(4, 52),
+    E(8, 58), E(14, 64), E(15, 70), E(17, 76), E(20, 80), E(23, 82), E(25, 84), E(28, 86)
+};
+
+const Score QUEEN_MOBILITY[28] = {
+    E(-20, -30), E(-12, -20), E(-4, -10), E(-2, -4), E(0, 0), E(2, 4), E(4, 8),
+    E(6, 12), E(8, 16), E(10, 20), E(11, 24), E(12, 28), E(13, 31), E(14, 34),
+    E(15, 37), E(16, 40), E(17, 42), E(18, 44), E(19, 46), E(20, 48), E(21, 50),
+    E(22, 51), E(23, 52), E(24, 53), E(25, 54), E(26, 55), E(27, 56), E(28, 57)
+};
+
+const Score BISHOP_PAIR = E(30, 50);
+const Score ROOK_OPEN_FILE = E(25, 10);
+const Score ROOK_SEMIOPEN_FILE = E(12, 6);
+
+const Score PASSED_PAWN[8] = {
+    E(0, 0), E(5, 10), E(8, 15), E(15, 25), E(30, 45), E(55, 80), E(90, 130), E(0, 0)
+};
+const Score ISOLATED_PAWN = E(-10, -15);
+const Score DOUBLED_PAWN = E(-12, -25);
+const Score BACKWARD_PAWN = E(-8, -12);
+const int PASSER_OWN_KING_DIST = 3;
+const int PASSER_ENEMY_KING_DIST = 6;
+const Score PASSER_BLOCKED = E(-5, -15);
+
+const int SHELTER_PAWN[3] = {-30, 20, 8};
+const int STORM_PAWN = -12;
+const int KING_ATTACK_WEIGHTS[6] = {0, 20, 20, 40, 80, 0};
+const int KING_ZONE_ATTACK = 8;
+const int SAFE_CHECK[6] = {0, 40, 30, 50, 70, 0};
+const int NO_QUEEN_DANGER = 100;
+
+const Score THREAT_BY_PAWN = E(55, 40);
+const Score THREAT_BY_MINOR[6] = {E(0, 0), E(10, 15), E(10, 15), E(35, 25), E(40, 40), E(0, 0)};
+const Score THREAT_BY_ROOK[6] = {E(0, 0), E(8, 15), E(8, 15), E(0, 0), E(40, 40), E(0, 0)};
+const Score HANGING_PIECE = E(25, 15);
+
+#ifdef TUNE
+thread_local EvalTrace evalTrace;
+
+// Every term has to be traced on every call, so nothing comes from the
+// pawn hash in a tuning build
+const bool USE_PAWN_HASH = false;
+
+const TuneGroup TUNE_GROUPS[] = {
+    {"PIECE_VALUES", TUNE_PIECE_VALUE, 6, TUNE_FORMAT_SPLIT},
+    {"PSQT", TUNE_PSQT, 6 * 64, TUNE_FORMAT_SPLIT},
+    {"KNIGHT_MOBILITY", TUNE_KNIGHT_MOBILITY, 9, TUNE_FORMAT_SCORE},
+    {"BISHOP_MOBILITY", TUNE_BISHOP_MOBILITY, 14, TUNE_FORMAT_SCORE},
+    {"ROOK_MOBILITY", TUNE_ROOK_MOBILITY, 15, TUNE_FORMAT_SCORE},
+    {"QUEEN_MOBILITY", TUNE_QUEEN_MOBILITY, 28, TUNE_FORMAT_SCORE},
+    {"BISHOP_PAIR", TUNE_BISHOP_PAIR, 1, TUNE_FORMAT_SCORE},
+    {"ROOK_OPEN_FILE", TUNE_ROOK_OPEN_FILE, 1, TUNE_FORMAT_SCORE},
+    {"ROOK_SEMIOPEN_FILE", TUNE_ROOK_SEMIOPEN_FILE, 1, TUNE_FORMAT_SCORE},
+    {"PASSED_PAWN", TUNE_PASSED_PAWN, 8, TUNE_FORMAT_SCORE},
+    {"ISOLATED_PAWN", TUNE_ISOLATED_PAWN, 1, TUNE_FORMAT_SCORE},
+    {"DOUBLED_PAWN", TUNE_DOUBLED_PAWN, 1, TUNE_FORMAT_SCORE},
+    {"BACKWARD_PAWN", TUNE_BACKWARD_PAWN, 1, TUNE_FORMAT_SCORE},
+    {"PASSER_OWN_KING_DIST", TUNE_PASSER_OWN_KING_DIST, 1, TUNE_FORMAT_EG},
+    {"PASSER_ENEMY_KING_DIST", TUNE_PASSER_ENEMY_KING_DIST, 1, TUNE_FORMAT_EG},
+    {"PASSER_BLOCKED", TUNE_PASSER_BLOCKED, 1, TUNE_FORMAT_SCORE},
+    {"SHELTER_PAWN", TUNE_SHELTER_PAWN, 3, TUNE_FORMAT_MG},
+    {"STORM_PAWN", TUNE_STORM_PAWN, 1, TUNE_FORMAT_MG},
+    {"THREAT_BY_PAWN", TUNE_THREAT_BY_PAWN, 1, TUNE_FORMAT_SCORE},
+    {"THREAT_BY_MINOR", TUNE_THREAT_BY_MINOR, 6, TUNE_FORMAT_SCORE},
+    {"THREAT_BY_ROOK", TUNE_THREAT_BY_ROOK, 6, TUNE_FORMAT_SCORE},
+    {"HANGING_PIECE", TUNE_HANGING_PIECE, 1, TUNE_FORMAT_SCORE}
+};
+const int NUM_TUNE_GROUPS = sizeof(TUNE_GROUPS) / sizeof(TUNE_GROUPS[0]);
+
+static void setWeights(int *mg, int *eg, int start, const Score *values, int count) {
+    for (int i = 0; i < count; i++) {
+        mg[start + i] = decEvalMg(values[i]);
+        eg[start + i] = decEvalEg(values[i]);
+    }
+}
+
+void getTuneWeights(int *mg, int *eg) {
+    for (int i = 0; i < NUM_TUNE_TERMS; i++)
+        mg[i] = eg[i] = 0;
+    for (int piece = PAWNS; piece <= KINGS; piece++) {
+        mg[TUNE_PIECE_VALUE + piece] = PIECE_VALUES_MG[piece];
+        eg[TUNE_PIECE_VALUE + piece] = PIECE_VALUES_EG[piece];
+        for (int sq = 0; sq < 64; sq++) {
+            mg[TUNE_PSQT + piece * 64 + sq] = PSQT_MG[piece][sq];
+            eg[TUNE_PSQT + piece * 64 + sq] = PSQT_EG[piece][sq];
+        }
+    }
+    setWeights(mg, eg, TUNE_KNIGHT_MOBILITY, KNIGHT_MOBILITY, 9);
+    setWeights(mg, eg, TUNE_BISHOP_MOBILITY, BISHOP_MOBILITY, 14);
+    setWeights(mg, eg, TUNE_ROOK_MOBILITY, ROOK_MOBILITY, 15);
+    setWeights(mg, eg, TUNE_QUEEN_MOBILITY, QUEEN_MOBILITY, 28);
+    setWeights(mg, eg, TUNE_BISHOP_PAIR, &BISHOP_PAIR, 1);
+    setWeights(mg, eg, TUNE_ROOK_OPEN_FILE, &ROOK_OPEN_FILE, 1);
+    setWeights(mg, eg, TUNE_ROOK_SEMIOPEN_FILE, &ROOK_SEMIOPEN_FILE, 1);
+    setWeights(mg, eg, TUNE_PASSED_PAWN, PASSED_PAWN, 8);
+    setWeights(mg, eg, TUNE_ISOLATED_PAWN, &ISOLATED_PAWN, 1);
+    setWeights(mg, eg, TUNE_DOUBLED_PAWN, &DOUBLED_PAWN, 1);
+    setWeights(mg, eg, TUNE_BACKWARD_PAWN, &BACKWARD_PAWN, 1);
+    eg[TUNE_PASSER_OWN_KING_DIST] = PASSER_OWN_KING_DIST;
+    eg[TUNE_PASSER_ENEMY_KING_DIST] = PASSER_ENEMY_KING_DIST;
+    setWeights(mg, eg, TUNE_PASSER_BLOCKED, &PASSER_BLOCKED, 1);
+    for (int i = 0; i < 3; i++)
+        mg[TUNE_SHELTER_PAWN + i] = SHELTER_PAWN[i];
+    mg[TUNE_STORM_PAWN] = STORM_PAWN;
+    setWeights(mg, eg, TUNE_THREAT_BY_PAWN, &THREAT_BY_PAWN, 1);
+    setWeights(mg, eg, TUNE_THREAT_BY_MINOR, THREAT_BY_MINOR, 6);
+    setWeights(mg, eg, TUNE_THREAT_BY_ROOK, THREAT_BY_ROOK, 6);
+    setWeights(mg, eg, TUNE_HANGING_PIECE, &HANGING_PIECE, 1);
+}
+
+// Material and piece-square terms come from Board's running sum, so they
+// are counted separately
+static void traceMaterial(Board &b) {
+    for (int colour = WHITE; colour <= BLACK; colour++) {
+        for (int piece = PAWNS; piece <= KINGS; piece++) {
+            uint64_t bb = b.getPieces(colour, piece);
+            while (bb) {
+                int sq = bitScanForward(bb);
+                bb &= bb - 1;
+                TRACE_ADD(TUNE_PIECE_VALUE + piece, colour, 1);
+                TRACE_ADD(TUNE_PSQT + piece * 64 + ((colour == WHITE) ? sq ^ 56 : sq), colour, 1);
+            }
+        }
+    }
+}
+#else
+const bool USE_PAWN_HASH = true;
+#endif
+
+static uint64_t passedMask[2][64];
+static uint64_t forwardRanks[2][8];
+static uint64_t forwardFile[2][64];
+static uint64_t supportMask[2][64];
+static uint64_t adjacentFiles[8];
+static int distance[64][64];
+
+static uint64_t shiftForward(uint64_t bb, int colour) {
+    return (colour == WHITE) ? bb << 8 : bb >> 8;
+}
+
+uint64_t pawnAttacks(uint64_t pawns, int colour) {
+    if (colour == WHITE)
+        return ((pawns & NOTA) << 7) | ((pawns & NOTH) << 9);
+    return ((pawns & NOTA) >> 9) | ((pawns & NOTH) >> 7);
+}
+
+void initEvalTables() {
+    for (int piece = PAWNS; piece <= KINGS; piece++) {
+        for (int sq = 0; sq < 64; sq++) {
+            Score s = E(PIECE_VALUES_MG[piece] + PSQT_MG[piece][sq ^ 56],
+                        PIECE_VALUES_EG[piece] + PSQT_EG[piece][sq ^ 56]);
+            pieceSquareTable[WHITE][piece][sq] = s;
+            Score t = E(PIECE_VALUES_MG[piece] + PSQT_MG[piece][sq],
+                        PIECE_VALUES_EG[piece] + PSQT_EG[piece][sq]);
+            pieceSquareTable[BLACK][piece][sq] = -t;
+        }
+    }
+
+    for (int f = 0; f < 8; f++)
+        adjacentFiles[f] = ((f > 0) ? FILES[f - 1] : 0) | ((f < 7) ? FILES[f + 1] : 0);
+
+    for (int sq = 0; sq < 64; sq++) {
+        int file = sq & 7, rank = sq >> 3;
+        uint64_t above = 0, below = 0;
+        for (int r = rank + 1; r < 8; r++) above |= RANKS[r];
+        for (int r = 0; r < rank; r++) below |= RANKS[r];
+        forwardRanks[WHITE][rank] = above;
+        forwardRanks[BLACK][rank] = below;
+
+        forwardFile[WHITE][sq] = FILES[file] & above;
+        forwardFile[BLACK][sq] = FILES[file] & below;
+        passedMask[WHITE][sq] = (FILES[file] | adjacentFiles[file]) & above;
+        passedMask[BLACK][sq] = (FILES[file] | adjacentFiles[file]) & below;
+        supportMask[WHITE][sq] = adjacentFiles[file] & ~above;
+        supportMask[BLACK][sq] = adjacentFiles[file] & ~below;
+
+        for (int sq2 = 0; sq2 < 64; sq2++) {
+            distance[sq][sq2] = std::max(std::abs(file - (sq2 & 7)),
+                                         std::abs(rank - (sq2 >> 3)));
+        }
+    }
+}
+
+int Eval::evaluate(Board &b) {
+#ifdef TUNE
+    evalTrace = EvalTrace();
+    traceMaterial(b);
+#endif
+    initAttackMaps(b);
+    PawnHashEntry *pawnEntry = probePawnHash(b);
+
+    Score score = b.getPsqtScore() + pawnEntry->score;
+    score += evaluatePieces(b, WHITE) - evaluatePieces(b, BLACK);
+    score += evaluatePassers(b, WHITE, pawnEntry) - evaluatePassers(b, BLACK, pawnEntry);
+    score += evaluateKingSafety(b, WHITE, pawnEntry) - evaluateKingSafety(b, BLACK, pawnEntry);
+    score += evaluateThreats(b, WHITE) - evaluateThreats(b, BLACK);
+
+    int phase = getPhase(b);
+    int mg = decEvalMg(score);
+    int scale = scaleFactor(b, decEvalEg(score));
+    int eg = decEvalEg(score) * scale / 64;
+    int value = (mg * phase + eg * (MAX_PHASE - phase)) / MAX_PHASE;
+#ifdef TUNE
+    evalTrace.score = score;
+    evalTrace.phase = phase;
+    evalTrace.scale = scale;
+#endif
+
+    return ((b.getPlayerToMove() == WHITE) ? value : -value) + TEMPO;
+}
+
+void Eval::clearCaches() {
+    pawnHash.clear();
+}
+
+PawnHashEntry *Eval::probePawnHash(Board &b) {
+    uint64_t pawnKey = b.getPawnKey();
+    PawnHashEntry *entry = pawnHash.get(pawnKey);
+    if (USE_PAWN_HASH && entry->key == pawnKey) {
+        pawnHash.hits++;
+    } else {
+        pawnHash.misses++;
+        entry->key = pawnKey;
+        entry->score = evaluatePawnStructure(b, WHITE, entry)
+                     - evaluatePawnStructure(b, BLACK, entry);
+        entry->kingSq[WHITE] = entry->kingSq[BLACK] = NO_KING_SQ;
+    }
+    return entry;
+}
+
+void Eval::initAttackMaps(Board &b) {
+    for (int colour = WHITE; colour <= BLACK; colour++) {
+        int kingSq = b.getKingSq(colour);
+        uint64_t pawnAtt = pawnAttacks(b.getPieces(colour, PAWNS), colour);
+        for (int piece = PAWNS; piece <= KINGS; piece++)
+            attackedBy[colour][piece] = 0;
+        attackedBy[colour][PAWNS] = pawnAtt;
+        attackedBy[colour][KINGS] = KINGMOVES[kingSq];
+        attackedByAll[colour] = pawnAtt | KINGMOVES[kingSq];
+        attackedBy2[colour] = pawnAtt & KINGMOVES[kingSq];
+
+        kingZone[colour] = KINGMOVES[kingSq] | indexToBit(kingSq);
+        kingZone[colour] |= shiftForward(kingZone[colour], colour);
+        kingAttackersCount[colour] = 0;
+        kingAttackersWeight[colour] = 0;
+        kingAttacksCount[colour] = 0;
+    }
+
+    for (int colour = WHITE; colour <= BLACK; colour++) {
+        mobilityArea[colour] = ~(b.getPieces(colour, PAWNS) | b.getPieces(colour, KINGS)
+                                 | attackedBy[1 - colour][PAWNS]);
+    }
+}
+
+Score Eval::evaluatePieces(Board &b, int colour) {
+    Score score = SCORE_ZERO;
+    int enemy = 1 - colour;
+    uint64_t occ = b.getOccupancy();
+    uint64_t ownPawns = b.getPieces(colour, PAWNS);
+    uint64_t enemyPawns = b.getPieces(enemy, PAWNS);
+
+    for (int piece = KNIGHTS; piece <= QUEENS; piece++) {
+        uint64_t bb = b.getPieces(colour, piece);
+        while (bb) {
+            int sq = bitScanForward(bb);
+            bb &= bb - 1;
+
+            uint64_t attacks;
+            switch (piece) {
+                case KNIGHTS: attacks = KNIGHTMOVES[sq]; break;
+                case BISHOPS: attacks = b.getBishopAttacks(sq, occ); break;
+                case ROOKS: attacks = b.getRookAttacks(sq, occ); break;
+                default: attacks = b.getBishopAttacks(sq, occ) | b.getRookAttacks(sq, occ); break;
+            }
+
+            attackedBy2[colour] |= attackedByAll[colour] & attacks;
+            attackedBy[colour][piece] |= attacks;
+            attackedByAll[colour] |= attacks;
+
+            if (attacks & kingZone[enemy]) {
+                kingAttackersCount[colour]++;
+                kingAttackersWeight[colour] += KING_ATTACK_WEIGHTS[piece];
+                kingAttacksCount[colour] += count(attacks & kingZone[enemy]);
+            }
+
+            int mobility = count(attacks & mobilityArea[colour]);
+            TRACE_ADD(MOBILITY_TERMS[piece] + mobility, colour, 1);
+            switch (piece) {
+                case KNIGHTS: score += KNIGHT_MOBILITY[mobility]; break;
+                case BISHOPS: score += BISHOP_MOBILITY[mobility]; break;
+                case ROOKS: score += ROOK_MOBILITY[mobility]; break;
+                default: score += QUEEN_MOBILITY[mobility]; break;
+            }
+
+            if (piece == ROOKS && !(FILES[sq & 7] & ownPawns)) {
+                bool semiOpen = FILES[sq & 7] & enemyPawns;
+                score += semiOpen ? ROOK_SEMIOPEN_FILE : ROOK_OPEN_FILE;
+                TRACE_ADD(semiOpen ? TUNE_ROOK_SEMIOPEN_FILE : TUNE_ROOK_OPEN_FILE, colour, 1);
+            }
+        }
+    }
+
+    if (count(b.getPieces(colour, BISHOPS)) >= 2) {
+        score += BISHOP_PAIR;
+        TRACE_ADD(TUNE_BISHOP_PAIR, colour, 1);
+    }
+
+    return score;
+}
+
+Score Eval::evaluatePawnStructure(Board &b, int colour, PawnHashEntry *entry) {
+    Score score = SCORE_ZERO;
+    int enemy = 1 - colour;
+    uint64_t ownPawns = b.getPieces(colour, PAWNS);
+    uint64_t enemyPawns = b.getPieces(enemy, PAWNS);
+    uint64_t enemyPawnAttacks = pawnAttacks(enemyPawns, enemy);
+    entry->passedPawns[colour] = 0;
+
+    uint64_t bb = ownPawns;
+    while (bb) {
+        int sq = bitScanForward(bb);
+        bb &= bb - 1;
+        int file = sq & 7;
+
+        if (!(adjacentFiles[file] & ownPawns)) {
+            score += ISOLATED_PAWN;
+            TRACE_ADD(TUNE_ISOLATED_PAWN, colour, 1);
+        } else if (!(supportMask[colour][sq] & ownPawns)
+              && (shiftForward(indexToBit(sq), colour) & enemyPawnAttacks)) {
+            score += BACKWARD_PAWN;
+            TRACE_ADD(TUNE_BACKWARD_PAWN, colour, 1);
+        }
+
+        if (forwardFile[colour][sq] & ownPawns) {
+            score += DOUBLED_PAWN;
+            TRACE_ADD(TUNE_DOUBLED_PAWN, colour, 1);
+        }
+
+        if (!(passedMask[colour][sq] & enemyPawns) && !(forwardFile[colour][sq] & ownPawns)) {
+            entry->passedPawns[colour] |= indexToBit(sq);
+            score += PASSED_PAWN[relativeRank(colour, sq >> 3)];
+            TRACE_ADD(TUNE_PASSED_PAWN + relativeRank(colour, sq >> 3), colour, 1);
+        }
+    }
+
+    return score;
+}
+
+// Passed pawn terms that depend on more than pawn placement
+Score Eval::evaluatePassers(Board &b, int colour, PawnHashEntry *entry) {
+    Score score = SCORE_ZERO;
+    int ownKing = b.getKingSq(colour);
+    int enemyKing = b.getKingSq(1 - colour);
+
+    uint64_t bb = entry->passedPawns[colour];
+    while (bb) {
+        int sq = bitScanForward(bb);
+        bb &= bb - 1;
+        int rank = relativeRank(colour, sq >> 3);
+
+        int stopSq = sq + ((colour == WHITE) ? 8 : -8);
+        if (rank >= 3) {
+            int kingBonus = distance[stopSq][enemyKing] * PASSER_ENEMY_KING_DIST
+                          - distance[stopSq][ownKing] * PASSER_OWN_KING_DIST;
+            score += E(0, kingBonus * (rank - 2));
+            TRACE_ADD(TUNE_PASSER_ENEMY_KING_DIST, colour, distance[stopSq][enemyKing] * (rank - 2));
+            TRACE_ADD(TUNE_PASSER_OWN_KING_DIST, colour, -distance[stopSq][ownKing] * (rank - 2));
+        }
+        if (b.getOccupancy() & indexToBit(stopSq)) {
+            score += PASSER_BLOCKED;
+            TRACE_ADD(TUNE_PASSER_BLOCKED, colour, 1);
+        }
+    }
+
+    return score;
+}
+
+// Pawn shelter in front of the king and enemy pawns storming it
+int Eval::evaluateShelter(Board &b, int colour, int kingSq) {
+    int kingFile = std::max(1, std::min(6, kingSq & 7));
+    uint64_t ownPawns = b.getPieces(colour, PAWNS);
+    uint64_t enemyPawns = b.getPieces(1 - colour, PAWNS);
+    uint64_t inFront = forwardRanks[colour][kingSq >> 3];
+
+    int shelter = 0;
+    for (int f = kingFile - 1; f <= kingFile + 1; f++) {
+        uint64_t ours = ownPawns & FILES[f] & inFront;
+        if (!ours) {
+            shelter += SHELTER_PAWN[0];
+            TRACE_ADD(TUNE_SHELTER_PAWN, colour, 1);
+        } else {
+            int sq = (colour == WHITE) ? bitScanForward(ours) : bitScanReverse(ours);
+            int dist = std::abs((sq >> 3) - (kingSq >> 3));
+            shelter += (dist <= 1) ? SHELTER_PAWN[1] : (dist == 2) ? SHELTER_PAWN[2] : 0;
+            if (dist <= 2)
+                TRACE_ADD(TUNE_SHELTER_PAWN + ((dist <= 1) ? 1 : 2), colour, 1);
+        }
+
+        uint64_t theirs = enemyPawns & FILES[f] & inFront;
+        if (theirs) {
+            int sq = (colour == WHITE) ? bitScanForward(theirs) : bitScanReverse(theirs);
+            if (std::abs((sq >> 3) - (kingSq >> 3)) <= 3) {
+                shelter += STORM_PAWN;
+                TRACE_ADD(TUNE_STORM_PAWN, colour, 1);
+            }
+        }
+    }
+
+    return shelter;
+}
+
+Score Eval::evaluateKingSafety(Board &b, int colour, PawnHashEntry *entry) {
+    int enemy = 1 - colour;
+    int kingSq = b.getKingSq(colour);
+
+    if (!USE_PAWN_HASH || entry->kingSq[colour] != kingSq) {
+        entry->kingSq[colour] = (uint8_t) kingSq;
+        entry->shelter[colour] = (int16_t) evaluateShelter(b, colour, kingSq);
+    }
+    int shelter = entry->shelter[colour];
+    Score score = E(shelter, 0);
+
+    // Attack units from enemy pieces bearing on the king zone
+    if (kingAttackersCount[enemy] > 1 - count(b.getPieces(enemy, QUEENS))) {
+        uint64_t occ = b.getOccupancy();
+        uint64_t safe = ~b.getAllPieces(enemy)
+                      & (~attackedByAll[colour] | (attackedBy2[enemy] & ~attackedBy2[colour]));
+        uint64_t knightChecks = KNIGHTMOVES[kingSq] & attackedBy[enemy][KNIGHTS] & safe;
+        uint64_t bishopChecks = b.getBishopAttacks(kingSq, occ) & attackedBy[enemy][BISHOPS] & safe;
+        uint64_t rookChecks = b.getRookAttacks(kingSq, occ) & attackedBy[enemy][ROOKS] & safe;
+        uint64_t queenChecks = (b.getBishopAttacks(kingSq, occ) | b.getRookAttacks(kingSq, occ))
+                             & attackedBy[enemy][QUEENS] & safe;
+
+        int danger = kingAttackersCount[enemy] * kingAttackersWeight[enemy]
+                   + KING_ZONE_ATTACK * kingAttacksCount[enemy]
+                   + SAFE_CHECK[KNIGHTS] * count(knightChecks)
+                   + SAFE_CHECK[BISHOPS] * count(bishopChecks)
+                   + SAFE_CHECK[ROOKS] * count(rookChecks)
+                   + SAFE_CHECK[QUEENS] * count(queenChecks)
+                   - 2 * shelter
+                   - (b.getPieces(enemy, QUEENS) ? 0 : NO_QUEEN_DANGER);
+
+        if (danger > 0)
+            score -= E(danger * danger / 1024, danger / 16);
+    }
+
+    return score;
+}
+
+Score Eval::evaluateThreats(Board &b, int colour) {
+    Score score = SCORE_ZERO;
+    int enemy = 1 - colour;
+    uint64_t nonPawnEnemies = b.getAllPieces(enemy) & ~b.getPieces(enemy, PAWNS)
+                            & ~b.getPieces(enemy, KINGS);
+
+    score += THREAT_BY_PAWN * count(attackedBy[colour][PAWNS] & nonPawnEnemies);
+    TRACE_ADD(TUNE_THREAT_BY_PAWN, colour, count(attackedBy[colour][PAWNS] & nonPawnEnemies));
+
+    uint64_t weak = b.getAllPieces(enemy) & ~b.getPieces(enemy, KINGS)
+                  & ~attackedBy[enemy][PAWNS] & attackedByAll[colour];
+    uint64_t minorTargets = weak & (attackedBy[colour][KNIGHTS] | attackedBy[colour][BISHOPS]);
+    uint64_t rookTargets = weak & attackedBy[colour][ROOKS];
+    for (int piece = KNIGHTS; piece <= QUEENS; piece++) {
+        score += THREAT_BY_MINOR[piece] * count(minorTargets & b.getPieces(enemy, piece));
+        score += THREAT_BY_ROOK[piece] * count(rookTargets & b.getPieces(enemy, piece));
+        TRACE_ADD(TUNE_THREAT_BY_MINOR + piece, colour, count(minorTargets & b.getPieces(enemy, piece)));
+        TRACE_ADD(TUNE_THREAT_BY_ROOK + piece, colour, count(rookTargets & b.getPieces(enemy, piece)));
+    }
+
+    uint64_t hanging = weak & ~attackedByAll[enemy];
+    score += HANGING_PIECE * count(hanging);
+    TRACE_ADD(TUNE_HANGING_PIECE, colour, count(hanging));
+
+    return score;
+}
+
+int Eval::getPhase(Board &b) {
+    int phase = 0;
+    for (int piece = KNIGHTS; piece <= QUEENS; piece++) {
+        phase += PHASE_WEIGHTS[piece] * count(b.getPieces(piece));
+    }
+    return std::min(phase, MAX_PHASE);
+}
+
+// Scale endgame scores out of 64 for drawish material configurations
+int Eval::scaleFactor(Board &b, int eg) {
+    int strong = (eg > 0) ? WHITE : BLACK;
+    int weak = 1 - strong;
+    if (b.getPieces(strong, PAWNS))
+        return 64;
+
+    int strongMaterial = b.getMaterial(strong);
+    int weakMaterial = b.getMaterial(weak);
+    if (strongMaterial - weakMaterial <= MATERIAL_VALUES[BISHOPS])
+        return (strongMaterial < MATERIAL_VALUES[ROOKS]) ? 0 : 16;
+    return 64;
+}
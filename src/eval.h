@@ -0,0 +1,118 @@
+#ifndef __EVAL_H__
+#define __EVAL_H__
+
+#include "board.h"
+#include "hash.h"
+
+const int MAX_PHASE = 24;
+const int PHASE_WEIGHTS[6] = {0, 1, 1, 2, 4, 0};
+
+const int PIECE_VALUES_MG[6] = {82, 337, 365, 477, 1025, 0};
+const int PIECE_VALUES_EG[6] = {94, 281, 297, 512, 936, 0};
+
+const Score TEMPO = 15;
+
+// Material plus piece-square bonus for every (colour, piece, square),
+// negated for black so that Board can keep one white-relative running sum
+extern Score pieceSquareTable[2][6][64];
+
+void initEvalTables();
+
+// Index of every tunable evaluation term. Each term has a midgame and an
+// endgame weight; a few only feed one half of the score.
+const int TUNE_PIECE_VALUE = 0;
+const int TUNE_PSQT = TUNE_PIECE_VALUE + 6;
+const int TUNE_KNIGHT_MOBILITY = TUNE_PSQT + 6 * 64;
+const int TUNE_BISHOP_MOBILITY = TUNE_KNIGHT_MOBILITY + 9;
+const int TUNE_ROOK_MOBILITY = TUNE_BISHOP_MOBILITY + 14;
+const int TUNE_QUEEN_MOBILITY = TUNE_ROOK_MOBILITY + 15;
+const int TUNE_BISHOP_PAIR = TUNE_QUEEN_MOBILITY + 28;
+const int TUNE_ROOK_OPEN_FILE = TUNE_BISHOP_PAIR + 1;
+const int TUNE_ROOK_SEMIOPEN_FILE = TUNE_ROOK_OPEN_FILE + 1;
+const int TUNE_PASSED_PAWN = TUNE_ROOK_SEMIOPEN_FILE + 1;
+const int TUNE_ISOLATED_PAWN = TUNE_PASSED_PAWN + 8;
+const int TUNE_DOUBLED_PAWN = TUNE_ISOLATED_PAWN + 1;
+const int TUNE_BACKWARD_PAWN = TUNE_DOUBLED_PAWN + 1;
+const int TUNE_PASSER_OWN_KING_DIST = TUNE_BACKWARD_PAWN + 1;
+const int TUNE_PASSER_ENEMY_KING_DIST = TUNE_PASSER_OWN_KING_DIST + 1;
+const int TUNE_PASSER_BLOCKED = TUNE_PASSER_ENEMY_KING_DIST + 1;
+const int TUNE_SHELTER_PAWN = TUNE_PASSER_BLOCKED + 1;
+const int TUNE_STORM_PAWN = TUNE_SHELTER_PAWN + 3;
+const int TUNE_THREAT_BY_PAWN = TUNE_STORM_PAWN + 1;
+const int TUNE_THREAT_BY_MINOR = TUNE_THREAT_BY_PAWN + 1;
+const int TUNE_THREAT_BY_ROOK = TUNE_THREAT_BY_MINOR + 6;
+const int TUNE_HANGING_PIECE = TUNE_THREAT_BY_ROOK + 6;
+const int NUM_TUNE_TERMS = TUNE_HANGING_PIECE + 1;
+
+const int MOBILITY_TERMS[6] = {
+    0, TUNE_KNIGHT_MOBILITY, TUNE_BISHOP_MOBILITY, TUNE_ROOK_MOBILITY, TUNE_QUEEN_MOBILITY, 0
+};
+
+#ifdef TUNE
+// How often each term was applied for each colour by the last evaluate() on
+// this thread, plus what the tuner needs to rebuild the final value. Only
+// built with -DTUNE (make TUNE=1).
+struct EvalTrace {
+    int16_t counts[NUM_TUNE_TERMS][2];
+    Score score;
+    int phase;
+    int scale;
+};
+
+extern thread_local EvalTrace evalTrace;
+#define TRACE_ADD(term, colour, n) (evalTrace.counts[term][colour] += (n))
+
+// The values are printed back in the layout of the declarations in eval.cpp
+const int TUNE_FORMAT_SCORE = 0;
+const int TUNE_FORMAT_SPLIT = 1;
+const int TUNE_FORMAT_MG = 2;
+const int TUNE_FORMAT_EG = 3;
+
+struct TuneGroup {
+    const char *name;
+    int start;
+    int count;
+    int format;
+};
+
+extern const TuneGroup TUNE_GROUPS[];
+extern const int NUM_TUNE_GROUPS;
+
+void getTuneWeights(int *mg, int *eg);
+#else
+#define TRACE_ADD(term, colour, n) ((void) 0)
+#endif
+
+class Eval {
+public:
+    int evaluate(Board &b);
+    void clearCaches();
+    const PawnHashTable &getPawnHash() const { return pawnHash; }
+
+private:
+    PawnHashTable pawnHash;
+
+    uint64_t attackedBy[2][6];
+    uint64_t attackedByAll[2];
+    uint64_t attackedBy2[2];
+    uint64_t mobilityArea[2];
+    uint64_t kingZone[2];
+    int kingAttackersCount[2];
+    int kingAttackersWeight[2];
+    int kingAttacksCount[2];
+
+    void initAttackMaps(Board &b);
+    Score evaluatePieces(Board &b, int colour);
+    PawnHashEntry *probePawnHash(Board &b);
+    Score evaluatePawnStructure(Board &b, int colour, PawnHashEntry *entry);
+    Score evaluatePassers(Board &b, int colour, PawnHashEntry *entry);
+    int evaluateShelter(Board &b, int colour, int kingSq);
+    Score evaluateKingSafety(Board &b, int colour, PawnHashEntry *entry);
+    Score evaluateThreats(Board &b, int colour);
+    int getPhase(Board &b);
+    int scaleFactor(Board &b, int eg);
+};
+
+uint64_t pawnAttacks(uint64_t pawns, int colour);
+
+#endif
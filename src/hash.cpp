@@ -0,0 +1,38 @@
+#include "hash.h"
+
+PawnHashTable::PawnHashTable() {
+    size = 1ULL << PAWN_HASH_BITS;
+    table = new PawnHashEntry[size];
+    clear();
+}
+
+PawnHashTable::~PawnHashTable() {
+    delete[] table;
+}
+
+void PawnHashTable::clear() {
+    hits = misses = 0;
+    for (uint64_t i = 0; i < size; i++) {
+        table[i].key = 0;
+        table[i].passedPawns[WHITE] = table[i].passedPawns[BLACK] = 0;
+        table[i].score = SCORE_ZERO;
+        table[i].shelter[WHITE] = table[i].shelter[BLACK] = 0;
+        table[i].kingSq[WHITE] = table[i].kingSq[BLACK] = NO_KING_SQ;
+    }
+}
+
+EvalHashTable::EvalHashTable() {
+    size = 1ULL << EVAL_HASH_BITS;
+    table = new uint64_t[size];
+    clear();
+}
+
+EvalHashTable::~EvalHashTable() {
+    delete[] table;
+}
+
+void EvalHashTable::clear() {
+    hits = misses = 0;
+    for (uint64_t i = 0; i < size; i++)
+        table[i] = 0;
+}
@@ -0,0 +1,77 @@
+#ifndef __HASH_H__
+#define __HASH_H__
+
+#include "common.h"
+
+const int PAWN_HASH_BITS = 14;
+const int EVAL_HASH_BITS = 16;
+const uint8_t NO_KING_SQ = 64;
+
+// Pawn structure terms depend only on pawn placement, so they are cached
+// under Board's pawn key. Shelter also depends on the king square and is
+// recomputed lazily when the king has moved since the entry was filled.
+struct PawnHashEntry {
+    uint64_t key;
+    uint64_t passedPawns[2];
+    Score score;
+    int16_t shelter[2];
+    uint8_t kingSq[2];
+};
+
+class PawnHashTable {
+public:
+    PawnHashTable();
+    ~PawnHashTable();
+
+    PawnHashEntry *get(uint64_t pawnKey) {
+        return &table[pawnKey & (size - 1)];
+    }
+    void clear();
+
+    uint64_t hits;
+    uint64_t misses;
+
+private:
+    PawnHashEntry *table;
+    uint64_t size;
+
+    PawnHashTable(const PawnHashTable &other);
+    PawnHashTable &operator=(const PawnHashTable &other);
+};
+
+// Static evaluations cached by Zobrist key. Each slot packs the upper 48
+// bits of the key with the 16-bit score, so a probe is a single load.
+class EvalHashTable {
+public:
+    EvalHashTable();
+    ~EvalHashTable();
+
+    bool probe(uint64_t key, int &score) {
+        uint64_t entry = table[key & (size - 1)];
+        if ((entry ^ key) >> 16) {
+            misses++;
+            return false;
+        }
+        hits++;
+        score = (int) (int16_t) (entry & 0xFFFF);
+        return true;
+    }
+
+    void store(uint64_t key, int score) {
+        table[key & (size - 1)] = (key & ~0xFFFFULL) | (uint16_t) (int16_t) score;
+    }
+
+    void clear();
+
+    uint64_t hits;
+    uint64_t misses;
+
+private:
+    uint64_t *table;
+    uint64_t size;
+
+    EvalHashTable(const EvalHashTable &other);
+    EvalHashTable &operator=(const EvalHashTable &other);
+};
+
+#endif
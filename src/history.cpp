@@ -0,0 +1,65 @@
+#include "history.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+static void applyGravity(int16_t &entry, int bonus) {
+    entry += bonus - entry * std::abs(bonus) / HISTORY_MAX;
+}
+
+History::History() {
+    continuation = new PieceToHistory[12][64];
+    clear();
+}
+
+History::~History() {
+    delete[] continuation;
+}
+
+void History::clear() {
+    clearKillers();
+    std::memset(counterMoves, 0, sizeof(counterMoves));
+    std::memset(butterfly, 0, sizeof(butterfly));
+    std::memset(continuation, 0, sizeof(PieceToHistory) * 12 * 64);
+}
+
+void History::clearKillers() {
+    std::memset(killers, 0, sizeof(killers));
+}
+
+int History::getQuietScore(int colour, Move m, int piece,
+        const PieceToHistory *cont1, const PieceToHistory *cont2) const {
+    int to = getEndSq(m);
+    int score = butterfly[colour][getStartSq(m)][to];
+    if (cont1)
+        score += (*cont1)[piece][to];
+    if (cont2)
+        score += (*cont2)[piece][to];
+    return score;
+}
+
+void History::addKiller(int ply, Move m) {
+    if (killers[ply][0] != m) {
+        killers[ply][1] = killers[ply][0];
+        killers[ply][0] = m;
+    }
+}
+
+void History::setCounterMove(int prevPiece, int prevTo, Move m) {
+    if (prevPiece != NO_PIECE)
+        counterMoves[prevPiece][prevTo] = m;
+}
+
+void History::updateQuiet(int colour, Move m, int piece,
+        PieceToHistory *cont1, PieceToHistory *cont2, int bonus) {
+    int to = getEndSq(m);
+    applyGravity(butterfly[colour][getStartSq(m)][to], bonus);
+    if (cont1)
+        applyGravity((*cont1)[piece][to], bonus);
+    if (cont2)
+        applyGravity((*cont2)[piece][to], bonus);
+}
+
+int History::bonus(int depth) {
+    return std::min(32 * depth * depth, MAX_HISTORY_BONUS);
+}
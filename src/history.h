@@ -0,0 +1,54 @@
+#ifndef __HISTORY_H__
+#define __HISTORY_H__
+
+#include "common.h"
+
+// Gravity bound for all history tables: updates shrink towards zero as an
+// entry approaches it, so values always fit in an int16_t
+const int HISTORY_MAX = 16384;
+const int MAX_HISTORY_BONUS = 2048;
+
+// Pieces are indexed colour * 6 + piece type
+const int NO_PIECE = -1;
+
+typedef int16_t PieceToHistory[12][64];
+
+// Move ordering statistics for quiet moves, owned by a single search
+// thread. Continuation history is indexed by the (piece, to) of the move
+// one or two plies earlier, so each node touches two contiguous blocks.
+class History {
+public:
+    History();
+    ~History();
+
+    void clear();
+    void clearKillers();
+
+    Move getKiller(int ply, int slot) const { return killers[ply][slot]; }
+    Move getCounterMove(int prevPiece, int prevTo) const {
+        return (prevPiece == NO_PIECE) ? NULL_MOVE : counterMoves[prevPiece][prevTo];
+    }
+    PieceToHistory *getContinuation(int prevPiece, int prevTo) {
+        return (prevPiece == NO_PIECE) ? NULL : &continuation[prevPiece][prevTo];
+    }
+
+    int getQuietScore(int colour, Move m, int piece,
+            const PieceToHistory *cont1, const PieceToHistory *cont2) const;
+    void addKiller(int ply, Move m);
+    void setCounterMove(int prevPiece, int prevTo, Move m);
+    void updateQuiet(int colour, Move m, int piece,
+            PieceToHistory *cont1, PieceToHistory *cont2, int bonus);
+
+    static int bonus(int depth);
+
+private:
+    Move killers[MAX_DEPTH + 1][2];
+    Move counterMoves[12][64];
+    int16_t butterfly[2][64][64];
+    PieceToHistory (*continuation)[64];
+
+    History(const History &other);
+    History &operator=(const History &other);
+};
+
+#endif
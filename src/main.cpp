@@ -1,17 +1,21 @@
 #include "common.h"
+#include "analyse.h"
+#include "bench.h"
 #include "bbinit.h"
 #include "board.h"
+#include "datagen.h"
+#include "eval.h"
 #include "perft.h"
+#include "pgn.h"
+#include "syzygy.h"
+#include "tune.h"
+#include "uci.h"
 #include <iostream>
+#include <string>
 
-int main() {
+int runDemo() {
     std::cout << "Brahma Chess Engine - Advanced Move Generation Test" << std::endl;
     
-    std::cout << "Initializing systems..." << std::endl;
-    initZobristTable();
-    initMagicTables(12345);
-    initInBetweenTable();
-    
     std::cout << "Creating board..." << std::endl;
     Board board;
     
@@ -21,7 +25,9 @@ int main() {
     std::cout << "Player to move: " << (board.getPlayerToMove() == WHITE ? "White" : "Black") << std::endl;
     
     std::cout << "\\n=== Move Generation Test ===" << std::endl;
-    MoveList allMoves = board.getAllLegalMove(WHITE);
+    ScoredMove buffer[MAX_MOVES];
+    ScoredMoveList allMoves(buffer);
+    board.getAllLegalMove(allMoves, WHITE);
     std::cout << "Legal moves for White: " << allMoves.size() << std::endl;
     
     std::cout << "\\n=== PERFT Validation ===" << std::endl;
@@ -50,4 +56,38 @@ int main() {
     std::cout << "\\nAdvanced move generation system operational!" << std::endl;
     
     return 0;
-}
\ No newline at end of file
+}
+
+int main(int argc, char **argv) {
+    initZobristTable();
+    initMagicTables();
+    initInBetweenTable();
+    initEvalTables();
+
+    if (argc > 1 && std::string(argv[1]) == "demo")
+        return runDemo();
+    if (argc > 1 && std::string(argv[1]) == "bench") {
+        int depth = DEFAULT_BENCH_DEPTH, threads = 1, hashMB = 16;
+        if ((argc > 2 && !parseNumber(argv[2], depth)) || (argc > 3 && !parseNumber(argv[3], threads))
+         || (argc > 4 && !parseNumber(argv[4], hashMB)) || depth < 1 || depth > MAX_DEPTH || threads < 1 || hashMB < 1) {
+            std::cout << "Usage: brahma bench [depth] [threads] [hash]" << std::endl;
+            return 1;
+        }
+        return runBench(depth, threads, hashMB);
+    }
+    if (argc > 1 && std::string(argv[1]) == "perft")
+        return PerftTester::runPerftSuite() ? 0 : 1;
+    if (argc > 1 && std::string(argv[1]) == "analyse")
+        return runAnalyse(argc - 2, argv + 2);
+    if (argc > 1 && std::string(argv[1]) == "datagen")
+        return runDatagen(argc - 2, argv + 2);
+    if (argc > 1 && std::string(argv[1]) == "extract")
+        return runExtract(argc - 2, argv + 2);
+    if (argc > 1 && std::string(argv[1]) == "tune")
+        return runTune(argc - 2, argv + 2);
+    if (argc > 2 && std::string(argv[1]) == "tbcheck")
+        return runTablebaseCheck(argv[2]);
+
+    uciLoop();
+    return 0;
+}
@@ -0,0 +1,303 @@
+#include "nnue.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
+// Quantisation: first layer activations are clipped to [0, 127], hidden
+// weights are scaled by 64 so hidden sums are shifted back down by 6
+const int HIDDEN_SHIFT = 6;
+const int ACTIVATION_MAX = 127;
+const int WEIGHT_SCALE = 64;
+const int NNUE_MAX_EVAL = 10000;
+
+// File layout: a 64 byte header followed by each parameter block, every
+// block starting on a 64 byte boundary so weights can be used in place
+struct NetworkHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t inputs;
+    uint32_t l1;
+    uint32_t l2;
+    int32_t outputScale;
+    uint8_t padding[40];
+};
+
+static size_t padded(size_t bytes) {
+    return (bytes + 63) & ~(size_t) 63;
+}
+
+static const size_t FT_WEIGHTS_SIZE = padded(sizeof(int16_t) * NNUE_INPUTS * NNUE_L1);
+static const size_t FT_BIAS_SIZE = padded(sizeof(int16_t) * NNUE_L1);
+static const size_t L1_WEIGHTS_SIZE = padded(sizeof(int8_t) * NNUE_L2 * 2 * NNUE_L1);
+static const size_t L1_BIAS_SIZE = padded(sizeof(int32_t) * NNUE_L2);
+static const size_t L2_WEIGHTS_SIZE = padded(sizeof(int8_t) * NNUE_L2);
+static const size_t L2_BIAS_SIZE = padded(sizeof(int32_t));
+static const size_t NETWORK_SIZE = sizeof(NetworkHeader) + FT_WEIGHTS_SIZE + FT_BIAS_SIZE
+    + L1_WEIGHTS_SIZE + L1_BIAS_SIZE + L2_WEIGHTS_SIZE + L2_BIAS_SIZE;
+
+static struct {
+    void *mapping;
+    const int16_t *ftWeights;
+    const int16_t *ftBias;
+    const int8_t *l1Weights;
+    const int32_t *l1Bias;
+    const int8_t *l2Weights;
+    const int32_t *l2Bias;
+    int outputScale;
+} net = {NULL, NULL, NULL, NULL, NULL, NULL, NULL, 0};
+
+static bool useNNUE = true;
+
+bool loadNetwork(const std::string &path) {
+    if (net.mapping) {
+        munmap(net.mapping, NETWORK_SIZE);
+        net.mapping = NULL;
+    }
+    if (path.empty() || path == "<empty>")
+        return false;
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        std::cout << "info string Could not open network " << path << std::endl;
+        return false;
+    }
+    struct stat statbuf;
+    fstat(fd, &statbuf);
+    if ((size_t) statbuf.st_size != NETWORK_SIZE) {
+        std::cout << "info string Network " << path << " has the wrong size" << std::endl;
+        close(fd);
+        return false;
+    }
+
+    void *base = mmap(NULL, NETWORK_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return false;
+
+    const NetworkHeader *header = (const NetworkHeader *) base;
+    if (std::memcmp(header->magic, "BRNN", 4) || header->version != NNUE_VERSION
+     || header->inputs != NNUE_INPUTS || header->l1 != NNUE_L1 || header->l2 != NNUE_L2) {
+        std::cout << "info string Network " << path << " has an unsupported format" << std::endl;
+        munmap(base, NETWORK_SIZE);
+        return false;
+    }
+
+    const uint8_t *data = (const uint8_t *) base + sizeof(NetworkHeader);
+    net.mapping = base;
+    net.ftWeights = (const int16_t *) data;
+    data += FT_WEIGHTS_SIZE;
+    net.ftBias = (const int16_t *) data;
+    data += FT_BIAS_SIZE;
+    net.l1Weights = (const int8_t *) data;
+    data += L1_WEIGHTS_SIZE;
+    net.l1Bias = (const int32_t *) data;
+    data += L1_BIAS_SIZE;
+    net.l2Weights = (const int8_t *) data;
+    data += L2_WEIGHTS_SIZE;
+    net.l2Bias = (const int32_t *) data;
+    net.outputScale = header->outputScale;
+
+    std::cout << "info string Loaded network " << path << std::endl;
+    return true;
+}
+
+bool isNetworkLoaded() {
+    return net.mapping != NULL;
+}
+
+void setUseNNUE(bool use) {
+    useNNUE = use;
+}
+
+bool isNNUEEnabled() {
+    return useNNUE && net.mapping != NULL;
+}
+
+static inline int featureIndex(int perspective, int kingSq, int piece, int sq) {
+    int colour = piece / 6;
+    int relative = (colour == perspective ? 0 : 6) + piece % 6;
+    if (perspective == BLACK) {
+        kingSq ^= 56;
+        sq ^= 56;
+    }
+    return (kingSq * 12 + relative) * 64 + sq;
+}
+
+// acc = prev + sum(adds) - sum(subs), one pass over the accumulator
+static void applyDeltas(const int16_t *prev, int16_t *acc,
+        const int16_t **adds, int addCount, const int16_t **subs, int subCount) {
+#if defined(__AVX512BW__)
+    for (int i = 0; i < NNUE_L1; i += 32) {
+        __m512i v = _mm512_load_si512((const __m512i *) (prev + i));
+        for (int j = 0; j < addCount; j++)
+            v = _mm512_add_epi16(v, _mm512_load_si512((const __m512i *) (adds[j] + i)));
+        for (int j = 0; j < subCount; j++)
+            v = _mm512_sub_epi16(v, _mm512_load_si512((const __m512i *) (subs[j] + i)));
+        _mm512_store_si512((__m512i *) (acc + i), v);
+    }
+#elif defined(__AVX2__)
+    for (int i = 0; i < NNUE_L1; i += 16) {
+        __m256i v = _mm256_load_si256((const __m256i *) (prev + i));
+        for (int j = 0; j < addCount; j++)
+            v = _mm256_add_epi16(v, _mm256_load_si256((const __m256i *) (adds[j] + i)));
+        for (int j = 0; j < subCount; j++)
+            v = _mm256_sub_epi16(v, _mm256_load_si256((const __m256i *) (subs[j] + i)));
+        _mm256_store_si256((__m256i *) (acc + i), v);
+    }
+#elif defined(__SSE4_1__)
+    for (int i = 0; i < NNUE_L1; i += 8) {
+        __m128i v = _mm_load_si128((const __m128i *) (prev + i));
+        for (int j = 0; j < addCount; j++)
+            v = _mm_add_epi16(v, _mm_load_si128((const __m128i *) (adds[j] + i)));
+        for (int j = 0; j < subCount; j++)
+            v = _mm_sub_epi16(v, _mm_load_si128((const __m128i *) (subs[j] + i)));
+        _mm_store_si128((__m128i *) (acc + i), v);
+    }
+#else
+    for (int i = 0; i < NNUE_L1; i++) {
+        int v = prev[i];
+        for (int j = 0; j < addCount; j++)
+            v += adds[j][i];
+        for (int j = 0; j < subCount; j++)
+            v -= subs[j][i];
+        acc[i] = (int16_t) v;
+    }
+#endif
+}
+
+// Clips the accumulator to [0, 127] and narrows it to bytes
+static void clippedRelu(const int16_t *acc, uint8_t *out) {
+#if defined(__AVX512BW__)
+    const __m512i maxValue = _mm512_set1_epi16(ACTIVATION_MAX);
+    // packus works within 128-bit lanes; this restores the input order
+    const __m512i order = _mm512_setr_epi64(0, 2, 4, 6, 1, 3, 5, 7);
+    for (int i = 0; i < NNUE_L1; i += 64) {
+        __m512i a = _mm512_min_epi16(_mm512_load_si512((const __m512i *) (acc + i)), maxValue);
+        __m512i b = _mm512_min_epi16(_mm512_load_si512((const __m512i *) (acc + i + 32)), maxValue);
+        __m512i packed = _mm512_maskz_permutexvar_epi64(0xFF, order, _mm512_packus_epi16(a, b));
+        _mm512_store_si512((__m512i *) (out + i), packed);
+    }
+#elif defined(__AVX2__)
+    const __m256i maxValue = _mm256_set1_epi16(ACTIVATION_MAX);
+    for (int i = 0; i < NNUE_L1; i += 32) {
+        __m256i a = _mm256_min_epi16(_mm256_load_si256((const __m256i *) (acc + i)), maxValue);
+        __m256i b = _mm256_min_epi16(_mm256_load_si256((const __m256i *) (acc + i + 16)), maxValue);
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+        _mm256_store_si256((__m256i *) (out + i), packed);
+    }
+#elif defined(__SSE4_1__)
+    const __m128i maxValue = _mm_set1_epi16(ACTIVATION_MAX);
+    for (int i = 0; i < NNUE_L1; i += 16) {
+        __m128i a = _mm_min_epi16(_mm_load_si128((const __m128i *) (acc + i)), maxValue);
+        __m128i b = _mm_min_epi16(_mm_load_si128((const __m128i *) (acc + i + 8)), maxValue);
+        _mm_store_si128((__m128i *) (out + i), _mm_packus_epi16(a, b));
+    }
+#else
+    for (int i = 0; i < NNUE_L1; i++)
+        out[i] = (uint8_t) std::max(0, std::min((int) acc[i], ACTIVATION_MAX));
+#endif
+}
+
+// Dot product of unsigned 8-bit activations with signed 8-bit weights
+static int dotProduct(const uint8_t *input, const int8_t *weights, int length) {
+#if defined(__AVX512BW__)
+    const __m512i ones = _mm512_set1_epi16(1);
+    __m512i sum = _mm512_setzero_si512();
+    for (int i = 0; i < length; i += 64) {
+        __m512i products = _mm512_maddubs_epi16(_mm512_load_si512((const __m512i *) (input + i)),
+                                                _mm512_load_si512((const __m512i *) (weights + i)));
+        sum = _mm512_add_epi32(sum, _mm512_madd_epi16(products, ones));
+    }
+    alignas(64) int32_t lanes[16];
+    _mm512_store_si512((__m512i *) lanes, sum);
+    int total = 0;
+    for (int i = 0; i < 16; i++)
+        total += lanes[i];
+    return total;
+#elif defined(__AVX2__)
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i sum = _mm256_setzero_si256();
+    for (int i = 0; i < length; i += 32) {
+        __m256i products = _mm256_maddubs_epi16(_mm256_load_si256((const __m256i *) (input + i)),
+                                                _mm256_load_si256((const __m256i *) (weights + i)));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(products, ones));
+    }
+    __m128i sum128 = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, 0x4E));
+    sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, 0xB1));
+    return _mm_cvtsi128_si32(sum128);
+#elif defined(__SSE4_1__)
+    const __m128i ones = _mm_set1_epi16(1);
+    __m128i sum = _mm_setzero_si128();
+    for (int i = 0; i < length; i += 16) {
+        __m128i products = _mm_maddubs_epi16(_mm_load_si128((const __m128i *) (input + i)),
+                                             _mm_load_si128((const __m128i *) (weights + i)));
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(products, ones));
+    }
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+    return _mm_cvtsi128_si32(sum);
+#else
+    int sum = 0;
+    for (int i = 0; i < length; i++)
+        sum += input[i] * weights[i];
+    return sum;
+#endif
+}
+
+void refreshAccumulator(Board &b, Accumulator &acc, int perspective) {
+    int kingSq = b.getKingSq(perspective);
+    const int16_t *adds[32];
+    int addCount = 0;
+    for (int colour = WHITE; colour <= BLACK; colour++) {
+        for (int piece = PAWNS; piece <= KINGS; piece++) {
+            uint64_t bb = b.getPieces(colour, piece);
+            while (bb) {
+                int feature = featureIndex(perspective, kingSq, colour * 6 + piece, bitScanForward(bb));
+                adds[addCount++] = net.ftWeights + feature * NNUE_L1;
+                bb &= bb - 1;
+            }
+        }
+    }
+    applyDeltas(net.ftBias, acc.values[perspective], adds, addCount, NULL, 0);
+    acc.computed[perspective] = true;
+}
+
+void updateAccumulator(const Accumulator &prev, Accumulator &acc, int kingSq, int perspective) {
+    const int16_t *adds[3];
+    const int16_t *subs[3];
+    int addCount = 0, subCount = 0;
+    for (int i = 0; i < acc.dirty.count; i++) {
+        if (acc.dirty.from[i] != NO_SQUARE)
+            subs[subCount++] = net.ftWeights
+                + featureIndex(perspective, kingSq, acc.dirty.piece[i], acc.dirty.from[i]) * NNUE_L1;
+        if (acc.dirty.to[i] != NO_SQUARE)
+            adds[addCount++] = net.ftWeights
+                + featureIndex(perspective, kingSq, acc.dirty.piece[i], acc.dirty.to[i]) * NNUE_L1;
+    }
+    applyDeltas(prev.values[perspective], acc.values[perspective], adds, addCount, subs, subCount);
+    acc.computed[perspective] = true;
+}
+
+int evaluateNetwork(const Accumulator &acc, int colour) {
+    alignas(64) uint8_t input[2 * NNUE_L1];
+    clippedRelu(acc.values[colour], input);
+    clippedRelu(acc.values[1 - colour], input + NNUE_L1);
+
+    int output = net.l2Bias[0];
+    for (int i = 0; i < NNUE_L2; i++) {
+        int hidden = (net.l1Bias[i] + dotProduct(input, net.l1Weights + i * 2 * NNUE_L1, 2 * NNUE_L1))
+                   >> HIDDEN_SHIFT;
+        output += std::max(0, std::min(hidden, ACTIVATION_MAX)) * net.l2Weights[i];
+    }
+
+    int score = (int) ((int64_t) output * net.outputScale / (ACTIVATION_MAX * WEIGHT_SCALE));
+    return std::max(-NNUE_MAX_EVAL, std::min(score, NNUE_MAX_EVAL));
+}
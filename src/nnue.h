@@ -0,0 +1,31 @@
+#ifndef __NNUE_H__
+#define __NNUE_H__
+
+#include "board.h"
+#include <string>
+
+// HalfKA features: (own king square, piece relative to the perspective,
+// square), with black's perspective mirrored vertically
+const int NNUE_INPUTS = 64 * 12 * 64;
+const int NNUE_L1 = 256;
+const int NNUE_L2 = 16;
+const int NNUE_VERSION = 1;
+
+// First layer output for both perspectives. Search keeps one per ply and
+// brings it up to date lazily from the parent using the recorded deltas.
+struct Accumulator {
+    alignas(64) int16_t values[2][NNUE_L1];
+    bool computed[2];
+    DirtyPiece dirty;
+};
+
+bool loadNetwork(const std::string &path);
+bool isNetworkLoaded();
+void setUseNNUE(bool use);
+bool isNNUEEnabled();
+
+void refreshAccumulator(Board &b, Accumulator &acc, int perspective);
+void updateAccumulator(const Accumulator &prev, Accumulator &acc, int kingSq, int perspective);
+int evaluateNetwork(const Accumulator &acc, int colour);
+
+#endif
@@ -0,0 +1,157 @@
+#include "packed.h"
+#include <cstring>
+#include <random>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+PackedPosition packPosition(Board &b, int score, int result) {
+    PackedPosition p;
+    std::memset(&p, 0, sizeof(p));
+    p.occupancy = b.getOccupancy();
+    uint64_t occ = p.occupancy;
+    for (int i = 0; occ && i < 32; i++) {
+        int sq = bitScanForward(occ);
+        occ &= occ - 1;
+        int colour = (b.getAllPieces(BLACK) & indexToBit(sq)) ? BLACK : WHITE;
+        int piece = colour * 6 + b.getPieceOnSquare(colour, sq);
+        p.pieces[i / 2] |= (uint8_t) (piece << (4 * (i & 1)));
+    }
+
+    p.flags = (uint8_t) (b.getEPCaptureFile() | (b.getPlayerToMove() << 4));
+    p.castlingRights = (uint8_t) b.getCastlingRights();
+    p.fiftyMoveCounter = (uint8_t) b.getFiftyMoveCounter();
+    p.result = (uint8_t) result;
+    p.score = (int16_t) score;
+    p.moveNumber = (uint16_t) b.getMoveNumber();
+    return p;
+}
+
+bool unpackPosition(const PackedPosition &p, Board &b) {
+    if (count(p.occupancy) > 32 || (p.flags & 0xF) > NO_EP_POSSIBLE || p.result > 2)
+        return false;
+
+    int mailbox[64];
+    int kings[2] = {0, 0};
+    for (int sq = 0; sq < 64; sq++)
+        mailbox[sq] = -1;
+    uint64_t occ = p.occupancy;
+    for (int i = 0; occ; i++) {
+        int sq = bitScanForward(occ);
+        occ &= occ - 1;
+        int piece = (p.pieces[i / 2] >> (4 * (i & 1))) & 0xF;
+        if (piece >= 12)
+            return false;
+        if (piece % 6 == KINGS)
+            kings[piece / 6]++;
+        mailbox[sq] = piece;
+    }
+    if (kings[WHITE] != 1 || kings[BLACK] != 1)
+        return false;
+
+    b = Board(mailbox,
+        p.castlingRights & WHITEKSIDE,
+        p.castlingRights & BLACKKSIDE,
+        p.castlingRights & WHITEQSIDE,
+        p.castlingRights & BLACKQSIDE,
+        p.flags & 0xF, p.fiftyMoveCounter, p.moveNumber, (p.flags >> 4) & 1);
+    return true;
+}
+
+bool isPackedFile(const std::string &path) {
+    return path.size() >= PACKED_EXTENSION.size()
+        && path.compare(path.size() - PACKED_EXTENSION.size(), PACKED_EXTENSION.size(),
+                        PACKED_EXTENSION) == 0;
+}
+
+PackedWriter::PackedWriter() {
+    file = NULL;
+    buffer = new PackedPosition[PACKED_WRITE_BUFFER];
+    length = 0;
+    failed = false;
+}
+
+PackedWriter::~PackedWriter() {
+    close();
+    delete[] buffer;
+}
+
+bool PackedWriter::open(const std::string &path) {
+    close();
+    file = std::fopen(path.c_str(), "ab");
+    failed = (file == NULL);
+    return !failed;
+}
+
+bool PackedWriter::flush() {
+    if (file && length && std::fwrite(buffer, sizeof(PackedPosition), length, file) != (size_t) length)
+        failed = true;
+    length = 0;
+    return !failed;
+}
+
+bool PackedWriter::close() {
+    if (!file)
+        return !failed;
+    flush();
+    if (std::fclose(file))
+        failed = true;
+    file = NULL;
+    return !failed;
+}
+
+PackedReader::PackedReader() {
+    records = NULL;
+    mappedSize = 0;
+    count = 0;
+}
+
+PackedReader::~PackedReader() {
+    close();
+}
+
+bool PackedReader::open(const std::string &path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+        return false;
+    struct stat statbuf;
+    fstat(fd, &statbuf);
+    size_t size = statbuf.st_size;
+    if (size == 0 || size % sizeof(PackedPosition)) {
+        ::close(fd);
+        return false;
+    }
+
+    void *base = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED)
+        return false;
+    madvise(base, size, MADV_SEQUENTIAL);
+
+    records = (const PackedPosition *) base;
+    mappedSize = size;
+    count = size / sizeof(PackedPosition);
+    return true;
+}
+
+void PackedReader::close() {
+    if (records)
+        munmap((void *) records, mappedSize);
+    records = NULL;
+    mappedSize = 0;
+    count = 0;
+    order.clear();
+}
+
+void PackedReader::shuffle(uint64_t seed) {
+    order.resize(count);
+    for (uint64_t i = 0; i < count; i++)
+        order[i] = i;
+    std::mt19937_64 rng(seed);
+    for (uint64_t i = count; i > 1; i--)
+        std::swap(order[i - 1], order[rng() % i]);
+    if (records)
+        madvise((void *) records, mappedSize, MADV_RANDOM);
+}
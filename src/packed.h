@@ -0,0 +1,95 @@
+#ifndef __PACKED_H__
+#define __PACKED_H__
+
+#include "board.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Files of packed positions are recognised by this extension
+const std::string PACKED_EXTENSION = ".packed";
+
+// Records buffered by PackedWriter before each write to disk
+const int PACKED_WRITE_BUFFER = 4096;
+
+// A labelled position in 32 bytes. The pieces are nibbles holding
+// colour * 6 + piece type for each occupied square in ascending order,
+// two to a byte with the lower square in the low nibble. Flags hold the
+// en passant file (NO_EP_POSSIBLE for none) in bits 0-3 and the side to
+// move in bit 4. The score is from white's point of view and the result
+// is white's score in half points. Records are written as they are laid out
+// in memory, so multi-byte fields are little endian.
+struct PackedPosition {
+    uint64_t occupancy;
+    uint8_t pieces[16];
+    uint8_t flags;
+    uint8_t castlingRights;
+    uint8_t fiftyMoveCounter;
+    uint8_t result;
+    int16_t score;
+    uint16_t moveNumber;
+};
+
+static_assert(sizeof(PackedPosition) == 32, "PackedPosition must be 32 bytes");
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "Packed files are little endian");
+
+PackedPosition packPosition(Board &b, int score, int result);
+// Returns false, leaving b alone, for a record that does not hold a board:
+// a bad piece code, more than 32 pieces or not one king a side, or a bad en
+// passant file or result
+bool unpackPosition(const PackedPosition &p, Board &b);
+bool isPackedFile(const std::string &path);
+
+// Appends packed positions to a file through a buffer. Call flush or close
+// to check that everything was written.
+class PackedWriter {
+public:
+    PackedWriter();
+    ~PackedWriter();
+
+    bool open(const std::string &path);
+    void write(const PackedPosition &p) {
+        buffer[length++] = p;
+        if (length == PACKED_WRITE_BUFFER)
+            flush();
+    }
+    bool flush();
+    bool close();
+
+private:
+    FILE *file;
+    PackedPosition *buffer;
+    int length;
+    bool failed;
+
+    PackedWriter(const PackedWriter &other);
+    PackedWriter &operator=(const PackedWriter &other);
+};
+
+// Memory maps a file of packed positions. Positions are read in file order
+// until shuffle is called, after which get follows a random permutation.
+class PackedReader {
+public:
+    PackedReader();
+    ~PackedReader();
+
+    bool open(const std::string &path);
+    void close();
+    void shuffle(uint64_t seed);
+
+    uint64_t size() const { return count; }
+    const PackedPosition &get(uint64_t i) const {
+        return records[order.empty() ? i : order[i]];
+    }
+
+private:
+    const PackedPosition *records;
+    size_t mappedSize;
+    uint64_t count;
+    std::vector<uint64_t> order;
+
+    PackedReader(const PackedReader &other);
+    PackedReader &operator=(const PackedReader &other);
+};
+
+#endif
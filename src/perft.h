@@ -20,7 +20,9 @@ class PerftTester {
 public:
     static PerftResult perft(Board &board, int depth, bool detailed = false);
     static void perftDivide(Board &board, int depth);
-    static void runPerftSuite();
+    // Node counts of the standard perft positions to depth 4. Returns false
+    // at the first count that differs.
+    static bool runPerftSuite();
     
 private:
     static PerftResult perftRecursive(Board &board, int depth, bool detailed);
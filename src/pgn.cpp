@@ -0,0 +1,401 @@
+#include "pgn.h"
+#include "packed.h"
+#include "uci.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+const char SAN_PIECES[] = "PNBRQK";
+const char PROMOTION_PIECES[] = "nbrq";
+const int EXTRACT_REPORT_BATCHES = 64;
+
+std::string moveToSAN(Board &b, Move m) {
+    int colour = b.getPlayerToMove();
+    int startSq = getStartSq(m);
+    int endSq = getEndSq(m);
+    int piece = b.getPieceOnSquare(colour, startSq);
+    std::string san;
+
+    if (isCastle(m)) {
+        san = ((endSq & 7) == 6) ? "O-O" : "O-O-O";
+    } else {
+        if (piece != PAWNS) {
+            san += SAN_PIECES[piece];
+            // Name the start file, rank or square when another piece of the
+            // same type can also reach endSq
+            ScoredMove buffer[MAX_MOVES];
+            ScoredMoveList legalMoves(buffer);
+            b.getAllLegalMove(legalMoves, colour);
+            bool ambiguous = false, sameFile = false, sameRank = false;
+            for (unsigned int i = 0; i < legalMoves.size(); i++) {
+                int otherSq = getStartSq(legalMoves.get(i));
+                if (getEndSq(legalMoves.get(i)) != endSq || otherSq == startSq
+                 || b.getPieceOnSquare(colour, otherSq) != piece)
+                    continue;
+                ambiguous = true;
+                sameFile |= (otherSq & 7) == (startSq & 7);
+                sameRank |= (otherSq >> 3) == (startSq >> 3);
+            }
+            if (ambiguous && (!sameFile || sameRank))
+                san += (char) ('a' + (startSq & 7));
+            if (ambiguous && sameFile)
+                san += (char) ('1' + (startSq >> 3));
+        } else if (isCapture(m)) {
+            san += (char) ('a' + (startSq & 7));
+        }
+        if (isCapture(m))
+            san += 'x';
+        san += (char) ('a' + (endSq & 7));
+        san += (char) ('1' + (endSq >> 3));
+        if (getPromotion(m)) {
+            san += '=';
+            san += SAN_PIECES[getPromotion(m)];
+        }
+    }
+
+    Board copy = b.staticCopy();
+    copy.doMove(m, colour);
+    if (copy.isInCheck(1 - colour))
+        san += copy.hasLegalMove(1 - colour) ? '+' : '#';
+    return san;
+}
+
+Move sanToMove(Board &b, const std::string &san) {
+    std::string s = san;
+    while (!s.empty() && std::strchr("+#!?", s.back()))
+        s.pop_back();
+    int colour = b.getPlayerToMove();
+    ScoredMove buffer[MAX_MOVES];
+    ScoredMoveList legalMoves(buffer);
+    b.getAllLegalMove(legalMoves, colour);
+
+    if (s == "O-O" || s == "0-0" || s == "O-O-O" || s == "0-0-0") {
+        int file = (s.size() == 3) ? 6 : 2;
+        for (unsigned int i = 0; i < legalMoves.size(); i++) {
+            Move m = legalMoves.get(i);
+            if (isCastle(m) && (getEndSq(m) & 7) == file)
+                return m;
+        }
+        return NULL_MOVE;
+    }
+    if (s.size() < 2)
+        return NULL_MOVE;
+
+    int piece = PAWNS;
+    size_t start = 0;
+    if (std::isupper((unsigned char) s[0]) && std::strchr(SAN_PIECES + 1, s[0])) {
+        piece = (int) (std::strchr(SAN_PIECES, s[0]) - SAN_PIECES);
+        start = 1;
+    }
+    // Promotions are accepted in either case, straight after the rank or '='
+    int promotion = 0;
+    const char *promotionPiece = std::strchr(PROMOTION_PIECES, std::tolower((unsigned char) s.back()));
+    if (piece == PAWNS && promotionPiece && *promotionPiece
+     && (std::isdigit((unsigned char) s[s.size() - 2]) || s[s.size() - 2] == '=')) {
+        promotion = (int) (promotionPiece - PROMOTION_PIECES) + 1;
+        s.pop_back();
+        if (s.back() == '=')
+            s.pop_back();
+    }
+    if (s.size() < start + 2)
+        return NULL_MOVE;
+
+    int toFile = s[s.size() - 2] - 'a';
+    int toRank = s[s.size() - 1] - '1';
+    if (toFile < 0 || toFile > 7 || toRank < 0 || toRank > 7)
+        return NULL_MOVE;
+    int fromFile = -1, fromRank = -1;
+    for (size_t i = start; i < s.size() - 2; i++) {
+        if (s[i] >= 'a' && s[i] <= 'h')
+            fromFile = s[i] - 'a';
+        else if (s[i] >= '1' && s[i] <= '8')
+            fromRank = s[i] - '1';
+        else if (s[i] != 'x' && s[i] != '-')
+            return NULL_MOVE;
+    }
+
+    Move found = NULL_MOVE;
+    for (unsigned int i = 0; i < legalMoves.size(); i++) {
+        Move m = legalMoves.get(i);
+        int startSq = getStartSq(m);
+        if (isCastle(m) || getEndSq(m) != 8 * toRank + toFile || getPromotion(m) != promotion
+         || b.getPieceOnSquare(colour, startSq) != piece)
+            continue;
+        if ((fromFile >= 0 && (startSq & 7) != fromFile) || (fromRank >= 0 && (startSq >> 3) != fromRank))
+            continue;
+        if (found != NULL_MOVE)
+            return NULL_MOVE;
+        found = m;
+    }
+    return found;
+}
+
+static int parseResult(const std::string &result) {
+    if (result == "1-0") return 2;
+    if (result == "0-1") return 0;
+    if (result == "1/2-1/2") return 1;
+    return PGN_NO_RESULT;
+}
+
+static bool isResultToken(const std::string &token) {
+    return token == "1-0" || token == "0-1" || token == "1/2-1/2" || token == "*";
+}
+
+static size_t skipVariation(const std::string &text, size_t i) {
+    int depth = 0;
+    for (; i < text.size(); i++) {
+        if (text[i] == '{') {
+            i = text.find('}', i);
+            if (i == std::string::npos)
+                return text.size();
+        } else if (text[i] == '(') {
+            depth++;
+        } else if (text[i] == ')' && --depth == 0) {
+            return i + 1;
+        }
+    }
+    return text.size();
+}
+
+bool parsePGNGame(const std::string &text, PGNGame &game) {
+    game.fen = STARTPOS;
+    game.result = PGN_NO_RESULT;
+    game.moves.clear();
+
+    Board b;
+    bool inMoves = false;
+    size_t i = 0;
+    while (i < text.size()) {
+        char c = text[i];
+        if (c == '[') {
+            if (inMoves)
+                break;
+            size_t lineEnd = std::min(text.find('\n', i), text.size());
+            size_t nameEnd = text.find_first_of(" \t\"", i + 1);
+            size_t valueStart = text.find('"', i);
+            size_t valueEnd = text.rfind('"', lineEnd - 1);
+            if (nameEnd < lineEnd && valueStart < lineEnd && valueEnd > valueStart) {
+                std::string name = text.substr(i + 1, nameEnd - i - 1);
+                std::string value = text.substr(valueStart + 1, valueEnd - valueStart - 1);
+                if (name == "FEN")
+                    game.fen = value;
+                else if (name == "Result")
+                    game.result = parseResult(value);
+            }
+            i = lineEnd;
+            continue;
+        }
+        if (std::isspace((unsigned char) c)) {
+            i++;
+            continue;
+        }
+        if (!inMoves) {
+            inMoves = true;
+            if (game.fen != STARTPOS)
+                b = fenToBoard(game.fen);
+        }
+
+        if (c == '{') {
+            i = std::min(text.find('}', i), text.size() - 1) + 1;
+        } else if (c == ';') {
+            i = std::min(text.find('\n', i), text.size());
+        } else if (c == '(') {
+            i = skipVariation(text, i);
+        } else if (c == ')') {
+            i++;
+        } else {
+            size_t end = std::min(text.find_first_of(" \t\r\n{}();[", i + 1), text.size());
+            std::string token = text.substr(i, end - i);
+            i = end;
+            if (isResultToken(token)) {
+                if (game.result == PGN_NO_RESULT)
+                    game.result = parseResult(token);
+                break;
+            }
+            if (token[0] == '$')
+                continue;
+
+            // Move numbers, possibly run into the move as in 1.e4
+            size_t digits = token.find_first_not_of("0123456789");
+            if (digits != std::string::npos && token[digits] == '.')
+                token = token.substr(std::min(token.find_first_not_of('.', digits), token.size()));
+            if (token.empty())
+                continue;
+
+            Move m = sanToMove(b, token);
+            if (m == NULL_MOVE)
+                return false;
+            game.moves.push_back(m);
+            b.doMove(m, b.getPlayerToMove());
+        }
+    }
+    return true;
+}
+
+bool PGNReader::open(const std::string &path) {
+    file.open(path);
+    pending.clear();
+    return file.is_open();
+}
+
+bool PGNReader::next(std::string &game) {
+    game.swap(pending);
+    pending.clear();
+    bool inMoves = false;
+    std::string line;
+    while (std::getline(file, line)) {
+        bool tag = !line.empty() && line[0] == '[';
+        if (tag && inMoves) {
+            pending = line + "\n";
+            return true;
+        }
+        if (!tag && line.find_first_not_of(" \t\r") != std::string::npos)
+            inMoves = true;
+        game += line;
+        game += '\n';
+    }
+    return game.find_first_not_of(" \t\r\n") != std::string::npos;
+}
+
+struct ExtractOptions {
+    std::string input;
+    std::string output;
+    int threads;
+};
+
+// One game's positions, as text lines or packed records for the output
+struct ExtractedGame {
+    std::string lines;
+    std::vector<PackedPosition> positions;
+    bool parsed;
+};
+
+static bool parseOptions(int argc, char **argv, ExtractOptions &options) {
+    options.threads = std::max(1, (int) std::thread::hardware_concurrency());
+    bool valid = true;
+    for (int i = 0; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        std::string value = argv[i + 1];
+        if (option == "--input") options.input = value;
+        else if (option == "--output") options.output = value;
+        else if (option == "--threads") valid &= parseNumber(value, options.threads);
+        else {
+            std::cout << "Unknown option " << option << std::endl;
+            return false;
+        }
+    }
+    options.threads = std::max(1, options.threads);
+    if (!valid || argc % 2 != 0 || options.input.empty() || options.output.empty()) {
+        std::cout << "Usage: brahma extract --input FILE --output FILE [--threads N]" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static void extractGame(const std::string &text, bool packed, ExtractedGame &extracted) {
+    const char *RESULTS[3] = {"0.0", "0.5", "1.0"};
+    PGNGame game;
+    extracted.parsed = parsePGNGame(text, game);
+    if (!extracted.parsed || game.result == PGN_NO_RESULT)
+        return;
+
+    Board b = fenToBoard(game.fen);
+    for (size_t ply = 0; ply <= game.moves.size(); ply++) {
+        if (packed)
+            extracted.positions.push_back(packPosition(b, 0, game.result));
+        else
+            extracted.lines += boardToFen(b) + " [" + RESULTS[game.result] + "]\n";
+        if (ply < game.moves.size())
+            b.doMove(game.moves[ply], b.getPlayerToMove());
+    }
+}
+
+int runExtract(int argc, char **argv) {
+    ExtractOptions options;
+    if (!parseOptions(argc, argv, options))
+        return 1;
+    PGNReader reader;
+    if (!reader.open(options.input)) {
+        std::cout << "Cannot open " << options.input << std::endl;
+        return 1;
+    }
+    bool packed = isPackedFile(options.output);
+    std::ofstream text;
+    PackedWriter packedWriter;
+    bool opened;
+    if (packed) {
+        opened = packedWriter.open(options.output);
+    } else {
+        text.open(options.output, std::ios::app);
+        opened = text.is_open();
+    }
+    if (!opened) {
+        std::cout << "Cannot open " << options.output << std::endl;
+        return 1;
+    }
+
+    ChessTime startTime = ChessClock::now();
+    uint64_t games = 0, positions = 0, unlabelled = 0, unreadable = 0;
+    std::vector<std::string> batch, nextBatch;
+    std::vector<ExtractedGame> extracted;
+    std::string game;
+    while (batch.size() < (size_t) PGN_BATCH_GAMES && reader.next(game))
+        batch.push_back(game);
+
+    for (int batches = 1; !batch.empty(); batches++) {
+        // The next batch is read while this one is parsed
+        extracted.assign(batch.size(), ExtractedGame());
+        std::vector<std::thread> workers;
+        for (int t = 0; t < options.threads; t++) {
+            workers.push_back(std::thread([&, t]() {
+                for (size_t i = t; i < batch.size(); i += options.threads)
+                    extractGame(batch[i], packed, extracted[i]);
+            }));
+        }
+        nextBatch.clear();
+        while (nextBatch.size() < (size_t) PGN_BATCH_GAMES && reader.next(game))
+            nextBatch.push_back(game);
+        for (std::thread &worker : workers)
+            worker.join();
+
+        for (const ExtractedGame &e : extracted) {
+            games++;
+            if (!e.parsed) {
+                unreadable++;
+                continue;
+            }
+            if (e.lines.empty() && e.positions.empty()) {
+                unlabelled++;
+                continue;
+            }
+            if (packed) {
+                for (const PackedPosition &p : e.positions)
+                    packedWriter.write(p);
+                positions += e.positions.size();
+            } else {
+                text << e.lines;
+                positions += std::count(e.lines.begin(), e.lines.end(), '\n');
+            }
+        }
+        batch.swap(nextBatch);
+
+        if (batches % EXTRACT_REPORT_BATCHES == 0) {
+            std::printf("games %llu positions %llu\n", (unsigned long long) games,
+                (unsigned long long) positions);
+            std::fflush(stdout);
+        }
+    }
+
+    bool written = packed ? packedWriter.close() : (bool) text.flush();
+    uint64_t elapsed = getTimeElapsed(startTime);
+    std::printf("games %llu positions %llu unlabelled %llu unreadable %llu games/s %llu time %llus\n",
+        (unsigned long long) games, (unsigned long long) positions, (unsigned long long) unlabelled,
+        (unsigned long long) unreadable, (unsigned long long) (games * 1000 / (elapsed ? elapsed : 1)),
+        (unsigned long long) elapsed / 1000);
+    if (!written)
+        std::cout << "Error writing " << options.output << std::endl;
+    return written ? 0 : 1;
+}
@@ -0,0 +1,55 @@
+#ifndef __PGN_H__
+#define __PGN_H__
+
+#include "board.h"
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Games read together by extract, then parsed in parallel
+const int PGN_BATCH_GAMES = 4096;
+const int PGN_NO_RESULT = -1;
+
+// Standard algebraic notation, with + or # for checks and mates
+std::string moveToSAN(Board &b, Move m);
+// Accepts check and annotation suffixes, 0-0 castling and promotions with
+// or without '='. Returns NULL_MOVE for an illegal or ambiguous move.
+Move sanToMove(Board &b, const std::string &san);
+
+struct PGNGame {
+    std::string fen;
+    // White's score in half points, or PGN_NO_RESULT
+    int result;
+    std::vector<Move> moves;
+};
+
+// Parses the tags and main line of one game, skipping comments, NAGs and
+// variations. Returns false if a move could not be read, leaving the moves
+// before it in game.
+bool parsePGNGame(const std::string &text, PGNGame &game);
+
+// Streams the text of one game at a time from a PGN file. A game ends where
+// the next tag section starts.
+class PGNReader {
+public:
+    PGNReader() {}
+
+    bool open(const std::string &path);
+    bool next(std::string &game);
+
+private:
+    std::ifstream file;
+    std::string pending;
+
+    PGNReader(const PGNReader &other);
+    PGNReader &operator=(const PGNReader &other);
+};
+
+// Writes the position before every move of every game with a result, and
+// each final position, labelled like datagen output. Options:
+//   --input FILE     PGN games
+//   --output FILE    file to append positions to, packed if named *.packed
+//   --threads N      parsing threads, all cores by default
+int runExtract(int argc, char **argv);
+
+#endif
@@ -0,0 +1,551 @@
+#include "search.h"
+#include "nnue.h"
+#include "syzygy.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+// Ordering scores are packed into 16 bits with each move. Quiet history
+// scores are scaled down to fit between the losing and the winning captures.
+const int PV_MOVE_SCORE = 32767;
+const int CAPTURE_SCORE = 24000;
+const int HISTORY_SCORE_DIVISOR = 4;
+const int KILLER_SCORE = CAPTURE_SCORE - 1;
+const int COUNTER_MOVE_SCORE = CAPTURE_SCORE - 3;
+const int QS_CHECK_PLIES = 3;
+const int DELTA_MARGIN = 200;
+// Tablebase wins are scored below any mate the search can find
+const int TB_WIN_SCORE = MATE_SCORE - 2 * MAX_DEPTH;
+
+static bool isQuiet(Move m) {
+    return !isCapture(m) && !isPromotion(m);
+}
+
+Searcher::Searcher() : rootMoves(&rootMoveBuffer[0]) {
+    stopSignal = false;
+    stopped = false;
+    nodes = 0;
+    tbHits = 0;
+    rootScore = 0;
+    rootDepth = 0;
+    multiPV = 1;
+    pvIndex = 0;
+    printInfo = true;
+    rootInTB = false;
+    tbCardinality = 0;
+    tbRootScore = 0;
+    gameKeys = 0;
+}
+
+void Searcher::setGameHistory(const std::vector<uint64_t> &keys) {
+    gameKeys = std::min((int) keys.size(), MAX_GAME_KEYS);
+    std::copy(keys.end() - gameKeys, keys.end(), keyHistory);
+}
+
+Move Searcher::getBestMove(Board &b, const SearchLimits &searchLimits) {
+    limits = searchLimits;
+    stopped = false;
+    nodes = 0;
+    tbHits = 0;
+    rootPV.length = 0;
+    rootScore = 0;
+    rootDepth = 0;
+    history.clearKillers();
+    accumulators[0].computed[WHITE] = accumulators[0].computed[BLACK] = false;
+    timeManager.init(limits, b.getPlayerToMove());
+
+    b.getAllLegalMove(rootMoves, b.getPlayerToMove());
+    unsigned int legalMoves = rootMoves.size();
+    if (legalMoves == 0)
+        return NULL_MOVE;
+
+    // With the root in the tablebases, search only the moves that keep the
+    // best DTZ outcome and stop probing inside the tree
+    rootInTB = false;
+    tbCardinality = getTablebaseCardinality();
+    int tbRank;
+    if (count(b.getOccupancy()) <= tbCardinality && !b.getCastlingRights()
+     && probeRootDTZ(b, rootMoves, tbRank)) {
+        rootInTB = true;
+        tbCardinality = 0;
+        tbHits = legalMoves;
+        tbRootScore = tbRank >= 900 ? TB_WIN_SCORE
+                    : tbRank > 0 ? std::max(3, tbRank - 800) / 2
+                    : tbRank == 0 ? 0
+                    : tbRank > -900 ? std::min(-3, tbRank + 800) / 2
+                    : -TB_WIN_SCORE;
+    }
+    Move bestMove = rootMoves.get(0);
+    int lines = std::min(multiPV, (int) rootMoves.size());
+    for (int line = 0; line < lines; line++)
+        multiPVLines[line].length = 0;
+
+    for (int depth = 1; depth <= limits.depth && depth <= MAX_DEPTH; depth++) {
+        // Each line gets a full window over the root moves that no better
+        // line has taken, and is ordered by its own line from the last
+        // iteration. History and caches carry over from one line to the next.
+        int completed = 0;
+        for (pvIndex = 0; pvIndex < lines; pvIndex++) {
+            rootPV = multiPVLines[pvIndex];
+            SearchPV pv;
+            int score = pvs(b, depth, 0, -INFTY, INFTY, pv);
+            if (stopped || pv.length == 0)
+                break;
+            multiPVLines[pvIndex] = pv;
+            multiPVScores[pvIndex] = score;
+            completed++;
+        }
+        pvIndex = 0;
+        if (completed == 0)
+            break;
+
+        bestMove = multiPVLines[0].moves[0];
+        rootPV = multiPVLines[0];
+        rootScore = multiPVScores[0];
+        rootDepth = depth;
+        if (printInfo) {
+            for (int line = 0; line < completed; line++)
+                printSearchInfo(depth, line);
+        }
+        if (completed < lines)
+            break;
+
+        timeManager.update(bestMove, rootScore);
+        // Nothing to think about with only one legal move
+        if (timeManager.isManaged() && rootMoves.size() == 1)
+            break;
+        if (timeManager.stopAfterIteration())
+            break;
+    }
+
+    return bestMove;
+}
+
+int Searcher::pvs(Board &b, int depth, int ply, int alpha, int beta, SearchPV &pv) {
+    pv.length = 0;
+    if (depth <= 0)
+        return quiescence(b, 0, ply, alpha, beta);
+
+    nodes++;
+    if (beta - alpha > 1)
+        STATS_INC(stats, pvNodes);
+    else
+        STATS_INC(stats, nonPvNodes);
+    if (checkStop())
+        return 0;
+
+    if (ply >= MAX_DEPTH)
+        return evaluate(b, ply);
+    keyHistory[gameKeys + ply] = b.getZobristKey();
+    if (ply > 0) {
+        if (b.isDraw() || isRepetition(b, ply)) {
+            STATS_INC(stats, drawNodes);
+            return 0;
+        }
+        // The side to move can force a draw by repeating an earlier position
+        if (alpha < 0 && hasUpcomingRepetition(b, ply)) {
+            if (beta <= 0)
+                return beta;
+            alpha = 0;
+        }
+    }
+
+    // Probe right after captures and pawn moves, where the table result
+    // cannot be spoilt by the fifty-move counter
+    if (ply > 0 && b.getFiftyMoveCounter() == 0 && !b.getCastlingRights()
+     && count(b.getOccupancy()) <= tbCardinality) {
+        int result;
+        int wdl = probeWDL(b, result);
+        if (result != PROBE_FAIL) {
+            tbHits++;
+            return wdl == WDL_WIN ? TB_WIN_SCORE - ply
+                 : wdl == WDL_LOSS ? -TB_WIN_SCORE + ply
+                 : wdl;
+        }
+    }
+
+    int colour = b.getPlayerToMove();
+    ScoredMove buffer[MAX_MOVES];
+    ScoredMoveList generated(buffer);
+    ScoredMoveList &moves = (ply == 0) ? rootMoves : generated;
+    STATS_TIMER_START(movegenTimer);
+    if (ply > 0)
+        b.getAllPseudoLegalMoves(generated, colour);
+    STATS_TIMER_STOP(stats, movegenCycles, movegenTimer);
+    STATS_ADD(stats, mainMoves, moves.size());
+    Move pvMove = (ply < rootPV.length) ? rootPV.moves[ply] : NULL_MOVE;
+    orderMoves(b, moves, pvMove, ply);
+
+    SearchPV line;
+    MoveList quietsTried;
+    int movesSearched = 0;
+    for (unsigned int i = 0; i < moves.size(); i++) {
+        Move m = moves.pickBest(i);
+        if (ply == 0 && isSearchedRootMove(m))
+            continue;
+        stack[ply].move = m;
+        stack[ply].piece = colour * 6 + b.getPieceOnSquare(colour, getStartSq(m));
+        STATS_TIMER_START(makeTimer);
+        Board copy = b.staticCopy();
+        bool legal = copy.doPseudoLegalMove(m, colour);
+        STATS_TIMER_STOP(stats, makeCycles, makeTimer);
+        if (!legal) {
+            STATS_INC(stats, illegalMoves);
+            continue;
+        }
+        markDirty(copy, ply + 1);
+
+        int score;
+        if (movesSearched == 0) {
+            score = -pvs(copy, depth - 1, ply + 1, -beta, -alpha, line);
+        } else {
+            score = -pvs(copy, depth - 1, ply + 1, -alpha - 1, -alpha, line);
+            if (alpha < score && score < beta)
+                score = -pvs(copy, depth - 1, ply + 1, -beta, -alpha, line);
+        }
+        movesSearched++;
+
+        if (stopped)
+            return 0;
+
+        if (score >= beta) {
+            STATS_INC(stats, betaCutoffs);
+            if (movesSearched == 1)
+                STATS_INC(stats, firstMoveCutoffs);
+            if (isQuiet(m))
+                updateQuietStats(b, depth, ply, m, quietsTried);
+            return beta;
+        }
+        if (score > alpha) {
+            alpha = score;
+            pv.update(m, line);
+        }
+        if (isQuiet(m))
+            quietsTried.add(m);
+    }
+
+    if (movesSearched == 0)
+        return b.isInCheck(colour) ? -MATE_SCORE + ply : 0;
+
+    return alpha;
+}
+
+int Searcher::quiescence(Board &b, int qply, int ply, int alpha, int beta) {
+    nodes++;
+    STATS_INC(stats, qsNodes);
+    if (checkStop())
+        return 0;
+    if (ply >= MAX_DEPTH)
+        return evaluate(b, ply);
+
+    int colour = b.getPlayerToMove();
+    bool inCheck = b.isInCheck(colour);
+    int standPat = -INFTY;
+    ScoredMove buffer[MAX_MOVES];
+    ScoredMoveList moves(buffer);
+
+    if (inCheck) {
+        STATS_INC(stats, inCheckNodes);
+        // No standing pat when in check: every evasion is searched
+        STATS_TIMER_START(movegenTimer);
+        b.getAllPseudoLegalMoves(moves, colour);
+        STATS_TIMER_STOP(stats, movegenCycles, movegenTimer);
+        STATS_ADD(stats, qsEvasions, moves.size());
+    } else {
+        standPat = evaluate(b, ply);
+        if (standPat >= beta)
+            return beta;
+        if (standPat > alpha)
+            alpha = standPat;
+        STATS_TIMER_START(movegenTimer);
+        b.getPseudoLegalCaptures(moves, colour, true);
+        STATS_TIMER_STOP(stats, movegenCycles, movegenTimer);
+        STATS_ADD(stats, qsCaptures, moves.size());
+    }
+    orderMoves(b, moves, NULL_MOVE, ply);
+
+    int movesSearched = 0;
+    for (unsigned int i = 0; i < moves.size(); i++) {
+        Move m = moves.pickBest(i);
+        if (!inCheck) {
+            // Delta pruning: even winning the victim outright cannot raise alpha
+            int victim = isEP(m) ? PAWNS : b.getPieceOnSquare(1 - colour, getEndSq(m));
+            int gain = (victim >= 0) ? MATERIAL_VALUES[victim] : 0;
+            if (isPromotion(m))
+                gain += MATERIAL_VALUES[QUEENS] - MATERIAL_VALUES[PAWNS];
+            if (standPat + gain + DELTA_MARGIN <= alpha) {
+                STATS_INC(stats, deltaPruned);
+                continue;
+            }
+            if (!b.seeGE(m, 0)) {
+                STATS_INC(stats, seePruned);
+                continue;
+            }
+        }
+
+        stack[ply].move = m;
+        stack[ply].piece = colour * 6 + b.getPieceOnSquare(colour, getStartSq(m));
+        STATS_TIMER_START(makeTimer);
+        Board copy = b.staticCopy();
+        bool legal = copy.doPseudoLegalMove(m, colour);
+        STATS_TIMER_STOP(stats, makeCycles, makeTimer);
+        if (!legal) {
+            STATS_INC(stats, illegalMoves);
+            continue;
+        }
+        markDirty(copy, ply + 1);
+        movesSearched++;
+
+        int score = -quiescence(copy, qply + 1, ply + 1, -beta, -alpha);
+        if (stopped)
+            return 0;
+        if (score >= beta)
+            return beta;
+        if (score > alpha)
+            alpha = score;
+    }
+
+    if (inCheck) {
+        if (movesSearched == 0)
+            return -MATE_SCORE + ply;
+        return alpha;
+    }
+
+    // Quiet checks are only tried close to the horizon, where missing a
+    // forcing sequence is most costly
+    if (qply < QS_CHECK_PLIES) {
+        STATS_TIMER_START(movegenTimer);
+        b.getPseudoLegalChecks(moves, colour);
+        STATS_TIMER_STOP(stats, movegenCycles, movegenTimer);
+        STATS_ADD(stats, qsChecks, moves.size());
+        for (unsigned int i = 0; i < moves.size(); i++) {
+            Move m = moves.get(i);
+            if (!b.seeGE(m, 0)) {
+                STATS_INC(stats, seePruned);
+                continue;
+            }
+
+            stack[ply].move = m;
+            stack[ply].piece = colour * 6 + b.getPieceOnSquare(colour, getStartSq(m));
+            STATS_TIMER_START(makeTimer);
+            Board copy = b.staticCopy();
+            bool legal = copy.doPseudoLegalMove(m, colour);
+            STATS_TIMER_STOP(stats, makeCycles, makeTimer);
+            if (!legal) {
+                STATS_INC(stats, illegalMoves);
+                continue;
+            }
+            markDirty(copy, ply + 1);
+
+            int score = -quiescence(copy, qply + 1, ply + 1, -beta, -alpha);
+            if (stopped)
+                return 0;
+            if (score >= beta)
+                return beta;
+            if (score > alpha)
+                alpha = score;
+        }
+    }
+
+    return alpha;
+}
+
+int Searcher::evaluate(Board &b, int ply) {
+    int score;
+    STATS_INC(stats, evalCalls);
+    STATS_TIMER_START(evalTimer);
+    if (!evalCache.probe(b.getZobristKey(), score)) {
+        score = isNNUEEnabled() ? evaluateNNUE(b, ply) : evaluator.evaluate(b);
+        evalCache.store(b.getZobristKey(), score);
+    } else {
+        STATS_INC(stats, evalCacheHits);
+    }
+    STATS_TIMER_STOP(stats, evalCycles, evalTimer);
+    return score;
+}
+
+// Brings the accumulator at ply up to date from the nearest computed
+// ancestor, or from scratch when that perspective's king has moved since
+void Searcher::updateAccumulators(Board &b, int ply) {
+    for (int perspective = WHITE; perspective <= BLACK; perspective++) {
+        if (accumulators[ply].computed[perspective])
+            continue;
+
+        int kingPiece = perspective * 6 + KINGS;
+        int start = ply;
+        bool refresh = false;
+        while (start > 0 && !accumulators[start].computed[perspective]) {
+            const DirtyPiece &dirty = accumulators[start].dirty;
+            for (int i = 0; i < dirty.count; i++)
+                if (dirty.piece[i] == kingPiece)
+                    refresh = true;
+            if (refresh)
+                break;
+            start--;
+        }
+
+        if (refresh || !accumulators[start].computed[perspective]) {
+            refreshAccumulator(b, accumulators[ply], perspective);
+        } else {
+            int kingSq = b.getKingSq(perspective);
+            for (int i = start + 1; i <= ply; i++)
+                updateAccumulator(accumulators[i - 1], accumulators[i], kingSq, perspective);
+        }
+    }
+}
+
+int Searcher::evaluateNNUE(Board &b, int ply) {
+    updateAccumulators(b, ply);
+    return evaluateNetwork(accumulators[ply], b.getPlayerToMove());
+}
+
+void Searcher::markDirty(const Board &child, int ply) {
+    accumulators[ply].dirty = child.getDirtyPiece();
+    accumulators[ply].computed[WHITE] = accumulators[ply].computed[BLACK] = false;
+}
+
+// Positions can only repeat with the same side to move and back to the last
+// capture or pawn move, so the scan is in steps of two and bounded by the
+// fifty-move counter
+bool Searcher::isRepetition(Board &b, int ply) {
+    int current = gameKeys + ply;
+    int end = std::min(b.getFiftyMoveCounter(), current);
+    uint64_t key = keyHistory[current];
+    bool repeated = false;
+    for (int i = 4; i <= end; i += 2) {
+        if (keyHistory[current - i] != key)
+            continue;
+        // A repeat within the search tree is a draw already, one which goes
+        // back into the game needs a third occurrence
+        if (i < ply || repeated)
+            return true;
+        repeated = true;
+    }
+    return false;
+}
+
+// Looks for an earlier position an odd number of plies back that differs
+// from this one by a single unblocked reversible move. Only cycles within
+// the search tree are considered.
+bool Searcher::hasUpcomingRepetition(Board &b, int ply) {
+    int current = gameKeys + ply;
+    int end = std::min(b.getFiftyMoveCounter(), ply - 1);
+    for (int i = 3; i <= end; i += 2) {
+        if (b.isReversibleMoveKey(keyHistory[current] ^ keyHistory[current - i]))
+            return true;
+    }
+    return false;
+}
+
+void Searcher::clearCaches() {
+    evaluator.clearCaches();
+    evalCache.clear();
+    history.clear();
+}
+
+static void printHitRate(const char *name, uint64_t hits, uint64_t misses) {
+    uint64_t probes = hits + misses;
+    std::cout << "info string " << name << " probes " << probes << " hits " << hits
+              << " misses " << misses << " hitrate "
+              << (probes ? hits * 1000 / probes : 0) / 10.0 << "%" << std::endl;
+}
+
+void Searcher::printCacheStats() {
+    printHitRate("evalcache", evalCache.hits, evalCache.misses);
+    const PawnHashTable &pawnHash = evaluator.getPawnHash();
+    printHitRate("pawnhash", pawnHash.hits, pawnHash.misses);
+}
+
+void Searcher::orderMoves(Board &b, ScoredMoveList &moves, Move pvMove, int ply) {
+    int colour = b.getPlayerToMove();
+    PieceToHistory *cont1 = continuationAt(ply - 1);
+    PieceToHistory *cont2 = continuationAt(ply - 2);
+    Move counterMove = (ply > 0)
+        ? history.getCounterMove(stack[ply - 1].piece, getEndSq(stack[ply - 1].move)) : NULL_MOVE;
+
+    for (unsigned int i = 0; i < moves.size(); i++) {
+        Move m = moves.get(i);
+        int score;
+        if (m == pvMove) {
+            score = PV_MOVE_SCORE;
+        } else if (isCapture(m) || (isPromotion(m) && getPromotion(m) == QUEENS)) {
+            int victim = isEP(m) ? PAWNS : b.getPieceOnSquare(1 - colour, getEndSq(m));
+            int attacker = b.getPieceOnSquare(colour, getStartSq(m));
+            score = 8 * ((victim >= 0) ? MATERIAL_VALUES[victim] : 0) - attacker + 1;
+            // Losing captures are tried after all quiet moves
+            score += b.seeGE(m, 0) ? CAPTURE_SCORE : -CAPTURE_SCORE;
+        } else if (m == history.getKiller(ply, 0)) {
+            score = KILLER_SCORE;
+        } else if (m == history.getKiller(ply, 1)) {
+            score = KILLER_SCORE - 1;
+        } else if (m == counterMove) {
+            score = COUNTER_MOVE_SCORE;
+        } else {
+            int piece = colour * 6 + b.getPieceOnSquare(colour, getStartSq(m));
+            score = history.getQuietScore(colour, m, piece, cont1, cont2) / HISTORY_SCORE_DIVISOR;
+        }
+        moves.setScore(i, score);
+    }
+}
+
+PieceToHistory *Searcher::continuationAt(int ply) {
+    if (ply < 0)
+        return NULL;
+    return history.getContinuation(stack[ply].piece, getEndSq(stack[ply].move));
+}
+
+void Searcher::updateQuietStats(Board &b, int depth, int ply, Move best, MoveList &quietsTried) {
+    int colour = b.getPlayerToMove();
+    int bonus = History::bonus(depth);
+    PieceToHistory *cont1 = continuationAt(ply - 1);
+    PieceToHistory *cont2 = continuationAt(ply - 2);
+
+    history.addKiller(ply, best);
+    if (ply > 0)
+        history.setCounterMove(stack[ply - 1].piece, getEndSq(stack[ply - 1].move), best);
+
+    history.updateQuiet(colour, best, colour * 6 + b.getPieceOnSquare(colour, getStartSq(best)),
+        cont1, cont2, bonus);
+    // Quiets that were searched first but failed to cut off are penalised
+    for (unsigned int i = 0; i < quietsTried.size(); i++) {
+        Move m = quietsTried.get(i);
+        history.updateQuiet(colour, m, colour * 6 + b.getPieceOnSquare(colour, getStartSq(m)),
+            cont1, cont2, -bonus);
+    }
+}
+
+bool Searcher::checkStop() {
+    if (stopped)
+        return true;
+    if (limits.nodes && nodes >= limits.nodes)
+        stopped = true;
+    else if ((nodes & (TIME_CHECK_INTERVAL - 1)) == 0)
+        stopped = stopSignal || timeManager.outOfTime();
+    return stopped;
+}
+
+bool Searcher::isSearchedRootMove(Move m) {
+    for (int line = 0; line < pvIndex; line++) {
+        if (multiPVLines[line].moves[0] == m)
+            return true;
+    }
+    return false;
+}
+
+void Searcher::printSearchInfo(int depth, int line) {
+    uint64_t time = timeManager.elapsed();
+    int score = reportedScore(multiPVScores[line]);
+    std::cout << "info depth " << depth;
+    if (multiPV > 1)
+        std::cout << " multipv " << line + 1;
+    std::cout << " score ";
+    if (isMateScore(score))
+        std::cout << "mate " << mateInMoves(score);
+    else
+        std::cout << "cp " << score;
+    std::cout << " time " << time << " nodes " << nodes
+              << " nps " << nodes * 1000 / time << " tbhits " << tbHits << " pv";
+    for (int i = 0; i < multiPVLines[line].length; i++)
+        std::cout << " " << moveToString(multiPVLines[line].moves[i]);
+    std::cout << std::endl;
+}
@@ -0,0 +1,126 @@
+#ifndef __SEARCH_H__
+#define __SEARCH_H__
+
+#include "board.h"
+#include "eval.h"
+#include "history.h"
+#include "nnue.h"
+#include "stats.h"
+#include "timeman.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <vector>
+
+// Positions played before the root which can still be repeated. Anything
+// older is cut off by the fifty-move rule.
+const int MAX_GAME_KEYS = 128;
+const int MAX_MULTI_PV = 64;
+
+inline bool isMateScore(int score) {
+    return std::abs(score) >= MATE_SCORE - MAX_DEPTH;
+}
+
+// Full moves to a mate, negative when the side to move is getting mated
+inline int mateInMoves(int score) {
+    return score > 0 ? (MATE_SCORE - score + 1) / 2 : -(MATE_SCORE + score) / 2;
+}
+
+struct SearchPV {
+    int length;
+    Move moves[MAX_DEPTH + 1];
+
+    SearchPV() {
+        length = 0;
+    }
+
+    void update(Move m, const SearchPV &child) {
+        moves[0] = m;
+        for (int i = 0; i < child.length; i++)
+            moves[i + 1] = child.moves[i];
+        length = child.length + 1;
+    }
+};
+
+struct SearchStackEntry {
+    Move move;
+    int piece;
+};
+
+class Searcher {
+public:
+    Searcher();
+
+    Move getBestMove(Board &b, const SearchLimits &searchLimits);
+    void stop() { stopSignal = true; }
+    void clearStop() { stopSignal = false; }
+    bool isStopRequested() const { return stopSignal; }
+    uint64_t getNodes() const { return nodes; }
+    // Score and depth of the last completed iteration, the score from the
+    // side to move. A root in the tablebases is scored by its DTZ outcome
+    // unless the search found a mate, as in the info lines.
+    int getScore() const { return reportedScore(rootScore); }
+    int getDepth() const { return rootDepth; }
+    uint64_t getTbHits() const { return tbHits; }
+    void setPrintInfo(bool print) { printInfo = print; }
+    // Number of best root moves searched and reported in each iteration
+    void setMultiPV(int lines) { multiPV = std::max(1, std::min(MAX_MULTI_PV, lines)); }
+    void setGameHistory(const std::vector<uint64_t> &keys);
+    void clearCaches();
+    void printCacheStats();
+    const SearchStats &getStats() const { return stats; }
+    void clearStats() { stats.clear(); }
+
+private:
+    SearchLimits limits;
+    TimeManager timeManager;
+    std::atomic<bool> stopSignal;
+    bool stopped;
+    uint64_t nodes;
+    uint64_t tbHits;
+    bool printInfo;
+    SearchPV rootPV;
+    // Lines of the last iteration in order of search. Root moves of lines
+    // before pvIndex are skipped, so each pass finds the next best move.
+    SearchPV multiPVLines[MAX_MULTI_PV];
+    int multiPVScores[MAX_MULTI_PV];
+    int multiPV;
+    int pvIndex;
+    int rootScore;
+    int rootDepth;
+    ScoredMove rootMoveBuffer[MAX_MOVES];
+    ScoredMoveList rootMoves;
+    bool rootInTB;
+    int tbCardinality;
+    int tbRootScore;
+    Eval evaluator;
+    EvalHashTable evalCache;
+    History history;
+    SearchStats stats;
+    SearchStackEntry stack[MAX_DEPTH + 1];
+    Accumulator accumulators[MAX_DEPTH + 1];
+    // Zobrist keys of the game followed by the current line, so the position
+    // at ply is keyHistory[gameKeys + ply]
+    uint64_t keyHistory[MAX_GAME_KEYS + MAX_DEPTH + 1];
+    int gameKeys;
+
+    int pvs(Board &b, int depth, int ply, int alpha, int beta, SearchPV &pv);
+    int quiescence(Board &b, int qply, int ply, int alpha, int beta);
+    int evaluate(Board &b, int ply);
+    int evaluateNNUE(Board &b, int ply);
+    void updateAccumulators(Board &b, int ply);
+    void markDirty(const Board &child, int ply);
+    bool isRepetition(Board &b, int ply);
+    bool hasUpcomingRepetition(Board &b, int ply);
+    void orderMoves(Board &b, ScoredMoveList &moves, Move pvMove, int ply);
+    PieceToHistory *continuationAt(int ply);
+    void updateQuietStats(Board &b, int depth, int ply, Move best, MoveList &quietsTried);
+    bool checkStop();
+    bool isSearchedRootMove(Move m);
+    int reportedScore(int score) const {
+        return (rootInTB && !isMateScore(score)) ? tbRootScore : score;
+    }
+    void printSearchInfo(int depth, int line);
+};
+
+#endif
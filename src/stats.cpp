@@ -0,0 +1,48 @@
+#include "stats.h"
+#include <iostream>
+
+// The counters are all uint64_t, so they can be handled as an array
+static const int COUNTERS = sizeof(SearchStats) / sizeof(uint64_t);
+
+void SearchStats::clear() {
+    uint64_t *counters = (uint64_t *) this;
+    for (int i = 0; i < COUNTERS; i++)
+        counters[i] = 0;
+}
+
+SearchStats &SearchStats::operator+=(const SearchStats &other) {
+    uint64_t *counters = (uint64_t *) this;
+    const uint64_t *otherCounters = (const uint64_t *) &other;
+    for (int i = 0; i < COUNTERS; i++)
+        counters[i] += otherCounters[i];
+    return *this;
+}
+
+#ifdef STATS
+static double percent(uint64_t part, uint64_t total) {
+    return total ? 100.0 * part / total : 0.0;
+}
+#endif
+
+void SearchStats::print(std::ostream &out) const {
+#ifndef STATS
+    out << "info string Statistics not compiled in, rebuild with make STATS=1" << std::endl;
+#else
+    uint64_t nodes = pvNodes + nonPvNodes + qsNodes;
+    uint64_t cycles = movegenCycles + makeCycles + evalCycles;
+    out << "info string nodes " << nodes
+              << " pv " << pvNodes << " nonpv " << nonPvNodes << " qs " << qsNodes
+              << " incheck " << inCheckNodes << " draws " << drawNodes << std::endl;
+    out << "info string eval calls " << evalCalls << " cachehits " << evalCacheHits
+              << " (" << percent(evalCacheHits, evalCalls) << "%)" << std::endl;
+    out << "info string moves main " << mainMoves << " qscaptures " << qsCaptures
+              << " qschecks " << qsChecks << " qsevasions " << qsEvasions
+              << " illegal " << illegalMoves << std::endl;
+    out << "info string cutoffs " << betaCutoffs << " firstmove "
+              << percent(firstMoveCutoffs, betaCutoffs) << "% qs deltapruned " << deltaPruned
+              << " seepruned " << seePruned << std::endl;
+    out << "info string cycles movegen " << percent(movegenCycles, cycles)
+              << "% make " << percent(makeCycles, cycles)
+              << "% eval " << percent(evalCycles, cycles) << "%" << std::endl;
+#endif
+}
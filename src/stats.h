@@ -0,0 +1,58 @@
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <cstdint>
+#include <iostream>
+
+// Search statistics, only collected when built with -DSTATS (make STATS=1).
+// Otherwise the macros expand to nothing and the counters stay at zero.
+#ifdef STATS
+#include <x86intrin.h>
+#define STATS_INC(stats, counter) ((stats).counter++)
+#define STATS_ADD(stats, counter, n) ((stats).counter += (n))
+#define STATS_TIMER_START(timer) uint64_t timer = __rdtsc()
+#define STATS_TIMER_STOP(stats, counter, timer) ((stats).counter += __rdtsc() - (timer))
+#else
+#define STATS_INC(stats, counter) ((void) 0)
+#define STATS_ADD(stats, counter, n) ((void) 0)
+#define STATS_TIMER_START(timer) ((void) 0)
+#define STATS_TIMER_STOP(stats, counter, timer) ((void) 0)
+#endif
+
+// Counters are kept by each searcher and only summed when reported
+struct SearchStats {
+    uint64_t pvNodes;
+    uint64_t nonPvNodes;
+    uint64_t qsNodes;
+    uint64_t inCheckNodes;
+    uint64_t drawNodes;
+
+    uint64_t evalCalls;
+    uint64_t evalCacheHits;
+
+    uint64_t mainMoves;
+    uint64_t qsCaptures;
+    uint64_t qsChecks;
+    uint64_t qsEvasions;
+    uint64_t illegalMoves;
+
+    uint64_t betaCutoffs;
+    uint64_t firstMoveCutoffs;
+    uint64_t deltaPruned;
+    uint64_t seePruned;
+
+    uint64_t movegenCycles;
+    uint64_t makeCycles;
+    uint64_t evalCycles;
+
+    SearchStats() {
+        clear();
+    }
+
+    void clear();
+    SearchStats &operator+=(const SearchStats &other);
+    // As info strings, to standard output unless another stream is given
+    void print(std::ostream &out = std::cout) const;
+};
+
+#endif
@@ -0,0 +1,1175 @@
+/*
+ * Syzygy tablebase probing, adapted to Brahma's board from tbprobe.c of
+ * Fathom (https://github.com/jdart1/Fathom), which carries this notice:
+ *
+ * Copyright (c) 2013-2020 Ronald de Man
+ * Copyright (c) 2015 basil00
+ * Modifications Copyright (c) 2016-2020 by Jon Dart
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "syzygy.h"
+#include "bbinit.h"
+#include "uci.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <climits>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const int TABLE_WDL = 0;
+const int TABLE_DTZ = 1;
+const uint32_t TB_MAGIC[2] = {0x5D23E871, 0xA50C66D7};
+const char *TB_SUFFIX[2] = {".rtbw", ".rtbz"};
+const char *PIECE_CHARS = "PNBRQK";
+
+// The flags byte of a DTZ table: bit 0 is the side to move it was built
+// for, bit 1 says values go through the per-outcome maps (16-bit maps if
+// bit 4 is set too), and bits 2 and 3 say wins and losses are stored in
+// plies rather than moves. Bit 7 marks a table holding a single value.
+const uint8_t PA_FLAGS[5] = {8, 0, 0, 0, 4};
+const int WDL_TO_MAP[5] = {1, 3, 0, 2, 0};
+const int WDL_TO_DTZ[5] = {-1, -101, 0, 101, 1};
+
+// Sign of rank - file, so which side of the a1-h8 diagonal a square is on
+const int8_t OFF_DIAG[64] = {
+    0,-1,-1,-1,-1,-1,-1,-1,
+    1, 0,-1,-1,-1,-1,-1,-1,
+    1, 1, 0,-1,-1,-1,-1,-1,
+    1, 1, 1, 0,-1,-1,-1,-1,
+    1, 1, 1, 1, 0,-1,-1,-1,
+    1, 1, 1, 1, 1, 0,-1,-1,
+    1, 1, 1, 1, 1, 1, 0,-1,
+    1, 1, 1, 1, 1, 1, 1, 0
+};
+
+// The 10 squares of the a1-d1-d4 triangle, diagonal squares last, and the
+// square of the triangle each square maps to by symmetry
+const int INV_TRIANGLE[10] = {1, 2, 3, 10, 11, 19, 0, 9, 18, 27};
+const uint8_t TRIANGLE[64] = {
+    6, 0, 1, 2, 2, 1, 0, 6,
+    0, 7, 3, 4, 4, 3, 7, 0,
+    1, 3, 8, 5, 5, 8, 3, 1,
+    2, 4, 5, 9, 9, 5, 4, 2,
+    2, 4, 5, 9, 9, 5, 4, 2,
+    1, 3, 8, 5, 5, 8, 3, 1,
+    0, 7, 3, 4, 4, 3, 7, 0,
+    6, 0, 1, 2, 2, 1, 0, 6
+};
+
+// Squares below the diagonal numbered 0-27, the diagonal itself 28-35
+const uint8_t LOWER[64] = {
+    28,  0,  1,  2,  3,  4,  5,  6,
+     0, 29,  7,  8,  9, 10, 11, 12,
+     1,  7, 30, 13, 14, 15, 16, 17,
+     2,  8, 13, 31, 18, 19, 20, 21,
+     3,  9, 14, 18, 32, 22, 23, 24,
+     4, 10, 15, 19, 22, 33, 25, 26,
+     5, 11, 16, 20, 23, 25, 34, 27,
+     6, 12, 17, 21, 24, 26, 27, 35
+};
+
+const uint8_t DIAG[64] = {
+     0,  0,  0,  0,  0,  0,  0,  8,
+     0,  1,  0,  0,  0,  0,  9,  0,
+     0,  0,  2,  0,  0, 10,  0,  0,
+     0,  0,  0,  3, 11,  0,  0,  0,
+     0,  0,  0, 12,  4,  0,  0,  0,
+     0,  0, 13,  0,  0,  5,  0,  0,
+     0, 14,  0,  0,  0,  0,  6,  0,
+    15,  0,  0,  0,  0,  0,  0,  7
+};
+
+// Pawn squares of the a-d files numbered file by file for the leading pawn,
+// and the order of the other leading pawns, nearest the edge and lowest
+// first
+const uint8_t FLAP[64] = {
+    0,  0,  0,  0,  0,  0,  0,  0,
+    0,  6, 12, 18, 18, 12,  6,  0,
+    1,  7, 13, 19, 19, 13,  7,  1,
+    2,  8, 14, 20, 20, 14,  8,  2,
+    3,  9, 15, 21, 21, 15,  9,  3,
+    4, 10, 16, 22, 22, 16, 10,  4,
+    5, 11, 17, 23, 23, 17, 11,  5,
+    0,  0,  0,  0,  0,  0,  0,  0
+};
+
+const uint8_t PAWN_TWIST[64] = {
+     0,  0,  0,  0,  0,  0,  0,  0,
+    47, 35, 23, 11, 10, 22, 34, 46,
+    45, 33, 21,  9,  8, 20, 32, 44,
+    43, 31, 19,  7,  6, 18, 30, 42,
+    41, 29, 17,  5,  4, 16, 28, 40,
+    39, 27, 15,  3,  2, 14, 26, 38,
+    37, 25, 13,  1,  0, 12, 24, 36,
+     0,  0,  0,  0,  0,  0,  0,  0
+};
+
+const int FILE_TO_FILE[8] = {0, 1, 2, 3, 3, 2, 1, 0};
+
+static int kkIdx[10][64];
+static uint64_t binomial[TB_MAX_PIECES][64];
+static uint64_t pawnIdx[TB_MAX_PIECES - 1][24];
+static uint64_t pawnFactor[TB_MAX_PIECES - 1][4];
+
+// Decoding information for one compressed table. Values are stored as
+// canonical Huffman codes in fixed-size blocks, where each symbol expands
+// into a run of values by recursive pairing.
+struct PairsData {
+    const uint8_t *indexTable;
+    const uint16_t *sizeTable;
+    const uint8_t *data;
+    const uint8_t *offset;
+    const uint8_t *symPat;
+    int blockSize;
+    int idxBits;
+    int minLen;
+    int constValue;
+    std::vector<uint64_t> base;
+    std::vector<uint8_t> symLen;
+};
+
+// Piece order and the multiplier of each group of pieces encoded together
+struct EncInfo {
+    PairsData precomp;
+    uint64_t factor[TB_MAX_PIECES];
+    uint8_t pieces[TB_MAX_PIECES];
+    uint8_t norm[TB_MAX_PIECES];
+};
+
+struct TBEntry {
+    std::string name;
+    uint64_t key;
+    uint64_t key2;
+    int num;
+    bool symmetric;
+    bool hasPawns;
+    bool kkEnc;
+    uint8_t pawns[2];
+    std::atomic<bool> ready[2];
+    void *mapping[2];
+    size_t mappingSize[2];
+    // WDL tables per side to move and leading pawn file (a-d), DTZ tables
+    // per file only
+    EncInfo wdl[2][4];
+    EncInfo dtz[4];
+    uint8_t dtzFlags[4];
+    const uint8_t *dtzMap;
+    uint32_t dtzMapIdx[4][4];
+
+    TBEntry(const std::string &_name);
+    ~TBEntry();
+};
+
+static std::vector<std::string> tbPaths;
+static std::deque<TBEntry> tbEntries;
+static std::unordered_map<uint64_t, TBEntry *> tbIndex;
+static int maxCardinality = 0;
+static int probeLimit = TB_MAX_PIECES;
+static std::mutex mapMutex;
+
+static inline uint16_t readLE16(const uint8_t *p) {
+    uint16_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t readLE32(const uint8_t *p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t readBE32(const uint8_t *p) {
+    return __builtin_bswap32(readLE32(p));
+}
+
+static inline uint64_t readBE64(const uint8_t *p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return __builtin_bswap64(v);
+}
+
+static inline int flipDiag(int sq) {
+    return ((sq >> 3) | (sq << 3)) & 63;
+}
+
+// Piece counts of each side packed four bits per piece type, white in the
+// low bits. Kings are implied.
+static uint64_t materialKey(Board &b) {
+    uint64_t key = 0;
+    for (int colour = WHITE; colour <= BLACK; colour++)
+        for (int piece = PAWNS; piece < KINGS; piece++)
+            key |= (uint64_t) count(b.getPieces(colour, piece)) << (4 * piece + 20 * colour);
+    return key;
+}
+
+static bool isMate(Board &b) {
+    int colour = b.getPlayerToMove();
+    return b.isInCheck(colour) && !b.hasLegalMove(colour);
+}
+
+static void initIndices() {
+    for (int k = 0; k < TB_MAX_PIECES; k++) {
+        for (int n = 0; n < 64; n++) {
+            int64_t f = 1, l = 1;
+            for (int i = 0; i < k; i++) {
+                f *= n - i;
+                l *= i + 1;
+            }
+            binomial[k][n] = (uint64_t) (f / l);
+        }
+    }
+
+    for (int k = 0; k < TB_MAX_PIECES - 1; k++) {
+        uint64_t s = 0;
+        for (int j = 0; j < 24; j++) {
+            pawnIdx[k][j] = s;
+            s += binomial[k][PAWN_TWIST[(1 + j % 6) * 8 + j / 6]];
+            if ((j + 1) % 6 == 0) {
+                pawnFactor[k][j / 6] = s;
+                s = 0;
+            }
+        }
+    }
+
+    // The 462 placements of two kings with the first in the triangle. With
+    // the first king on the diagonal the second may not be above it, and
+    // placements with both kings on the diagonal come last.
+    int code = 0;
+    std::vector<std::pair<int, int> > onDiagonal;
+    for (int t = 0; t < 10; t++) {
+        int s1 = INV_TRIANGLE[t];
+        for (int s2 = 0; s2 < 64; s2++) {
+            kkIdx[t][s2] = -1;
+            if ((KINGMOVES[s1] | indexToBit(s1)) & indexToBit(s2))
+                continue;
+            if (!OFF_DIAG[s1] && OFF_DIAG[s2] > 0)
+                continue;
+            if (!OFF_DIAG[s1] && !OFF_DIAG[s2])
+                onDiagonal.push_back(std::make_pair(t, s2));
+            else
+                kkIdx[t][s2] = code++;
+        }
+    }
+    for (unsigned int i = 0; i < onDiagonal.size(); i++)
+        kkIdx[onDiagonal[i].first][onDiagonal[i].second] = code++;
+}
+
+TBEntry::TBEntry(const std::string &_name) {
+    name = _name;
+    ready[TABLE_WDL] = ready[TABLE_DTZ] = false;
+    mapping[TABLE_WDL] = mapping[TABLE_DTZ] = NULL;
+    mappingSize[TABLE_WDL] = mappingSize[TABLE_DTZ] = 0;
+    dtzMap = NULL;
+
+    // A name like KRPvKR lists the stronger side first
+    int counts[2][6] = {};
+    int side = 0;
+    for (char c : name) {
+        if (c == 'v') {
+            side = 1;
+            continue;
+        }
+        counts[side][std::strchr(PIECE_CHARS, c) - PIECE_CHARS]++;
+    }
+
+    key = key2 = 0;
+    num = 0;
+    int uniquePieces = 0;
+    for (int s = 0; s < 2; s++) {
+        for (int piece = PAWNS; piece <= KINGS; piece++) {
+            num += counts[s][piece];
+            uniquePieces += (counts[s][piece] == 1);
+            if (piece != KINGS) {
+                key |= (uint64_t) counts[s][piece] << (4 * piece + 20 * s);
+                key2 |= (uint64_t) counts[s][piece] << (4 * piece + 20 * (1 - s));
+            }
+        }
+    }
+    symmetric = (key == key2);
+    hasPawns = counts[0][PAWNS] || counts[1][PAWNS];
+    // Only the kings are unique, so they lead the encoding together
+    kkEnc = (uniquePieces == 2);
+
+    // The leading colour is the side with fewer pawns, if it has any
+    pawns[0] = counts[0][PAWNS];
+    pawns[1] = counts[1][PAWNS];
+    if (pawns[1] && (!pawns[0] || pawns[0] > pawns[1]))
+        std::swap(pawns[0], pawns[1]);
+}
+
+TBEntry::~TBEntry() {
+    for (int type = TABLE_WDL; type <= TABLE_DTZ; type++)
+        if (mapping[type])
+            munmap(mapping[type], mappingSize[type]);
+}
+
+static const uint8_t *mapFile(TBEntry &be, int type) {
+    std::string fileName = be.name + TB_SUFFIX[type];
+    for (unsigned int i = 0; i < tbPaths.size(); i++) {
+        std::string path = tbPaths[i] + "/" + fileName;
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd == -1)
+            continue;
+
+        struct stat statbuf;
+        fstat(fd, &statbuf);
+        if (statbuf.st_size % 64 != 16) {
+            std::cerr << "info string Corrupt tablebase file " << path << std::endl;
+            close(fd);
+            return NULL;
+        }
+
+        void *base = mmap(NULL, statbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (base == MAP_FAILED)
+            return NULL;
+        madvise(base, statbuf.st_size, MADV_RANDOM);
+
+        if (readLE32((const uint8_t *) base) != TB_MAGIC[type]) {
+            std::cerr << "info string Corrupt tablebase file " << path << std::endl;
+            munmap(base, statbuf.st_size);
+            return NULL;
+        }
+
+        be.mapping[type] = base;
+        be.mappingSize[type] = statbuf.st_size;
+        return (const uint8_t *) base;
+    }
+    return NULL;
+}
+
+// Reads the piece order of one table and computes the multiplier of each
+// group. The leading group is three unique pieces, the two kings, or the
+// leading pawns; the pawns of the other colour come next if there are any,
+// then each set of identical pieces. Returns the size of the table.
+static uint64_t initEncInfo(EncInfo &ei, TBEntry &be, const uint8_t *tb, int shift, int t) {
+    bool morePawns = be.hasPawns && be.pawns[1];
+
+    for (int i = 0; i < be.num; i++) {
+        ei.pieces[i] = (tb[i + 1 + morePawns] >> shift) & 0xF;
+        ei.norm[i] = 0;
+    }
+
+    int order = (tb[0] >> shift) & 0xF;
+    int order2 = morePawns ? (tb[1] >> shift) & 0xF : 0xF;
+
+    int k = ei.norm[0] = be.hasPawns ? be.pawns[0] : be.kkEnc ? 2 : 3;
+    if (morePawns) {
+        ei.norm[k] = be.pawns[1];
+        k += ei.norm[k];
+    }
+    for (int i = k; i < be.num; i += ei.norm[i])
+        for (int j = i; j < be.num && ei.pieces[j] == ei.pieces[i]; j++)
+            ei.norm[i]++;
+
+    int freeSquares = 64 - k;
+    uint64_t f = 1;
+    for (int i = 0; k < be.num || i == order || i == order2; i++) {
+        if (i == order) {
+            ei.factor[0] = f;
+            f *= be.hasPawns ? pawnFactor[ei.norm[0] - 1][t] : be.kkEnc ? 462 : 31332;
+        } else if (i == order2) {
+            ei.factor[ei.norm[0]] = f;
+            f *= binomial[ei.norm[ei.norm[0]]][48 - ei.norm[0]];
+        } else {
+            ei.factor[k] = f;
+            f *= binomial[ei.norm[k]][freeSquares];
+            freeSquares -= ei.norm[k];
+            k += ei.norm[k];
+        }
+    }
+    return f;
+}
+
+static void calcSymLen(PairsData &d, int s, std::vector<bool> &done) {
+    const uint8_t *w = d.symPat + 3 * s;
+    int s2 = (w[2] << 4) | (w[1] >> 4);
+    if (s2 == 0xFFF) {
+        d.symLen[s] = 0;
+    } else {
+        int s1 = ((w[1] & 0xF) << 8) | w[0];
+        if (!done[s1])
+            calcSymLen(d, s1, done);
+        if (!done[s2])
+            calcSymLen(d, s2, done);
+        d.symLen[s] = d.symLen[s1] + d.symLen[s2] + 1;
+    }
+    done[s] = true;
+}
+
+// Reads the header of one compressed table and returns where the next one
+// starts. size receives the lengths of its index, block size and data
+// sections, which are stored further on.
+static const uint8_t *setupPairs(PairsData &d, const uint8_t *data, uint64_t tbSize,
+        uint64_t size[3], uint8_t &flags, int type) {
+    flags = data[0];
+    if (data[0] & 0x80) {
+        d.idxBits = 0;
+        d.constValue = (type == TABLE_WDL) ? data[1] : 0;
+        size[0] = size[1] = size[2] = 0;
+        return data + 2;
+    }
+
+    d.blockSize = data[1];
+    d.idxBits = data[2];
+    uint32_t realNumBlocks = readLE32(data + 4);
+    uint32_t numBlocks = realNumBlocks + data[3];
+    int maxLen = data[8];
+    d.minLen = data[9];
+    int h = maxLen - d.minLen + 1;
+    int numSyms = readLE16(data + 10 + 2 * h);
+    d.offset = data + 10;
+    d.symPat = data + 12 + 2 * h;
+
+    uint64_t numIndices = (tbSize + (1ULL << d.idxBits) - 1) >> d.idxBits;
+    size[0] = 6 * numIndices;
+    size[1] = 2 * (uint64_t) numBlocks;
+    size[2] = (uint64_t) realNumBlocks << d.blockSize;
+
+    d.symLen.assign(numSyms, 0);
+    std::vector<bool> done(numSyms);
+    for (int s = 0; s < numSyms; s++)
+        if (!done[s])
+            calcSymLen(d, s, done);
+
+    // Longer codes have lower values, so the first code of each length,
+    // left-aligned to 64 bits, is the threshold for decoding the length of
+    // the next symbol
+    d.base.assign(h, 0);
+    for (int i = h - 2; i >= 0; i--)
+        d.base[i] = (d.base[i + 1] + readLE16(d.offset + 2 * i) - readLE16(d.offset + 2 * i + 2)) / 2;
+    for (int i = 0; i < h; i++)
+        d.base[i] <<= 64 - (d.minLen + i);
+
+    return data + 12 + 2 * h + 3 * numSyms + (numSyms & 1);
+}
+
+// Lays the tables of a freshly mapped file out: the piece orders of each
+// table, then the compression headers, the DTZ maps, the sparse indices,
+// the block sizes and finally the 64-byte aligned compressed data
+static bool initTable(TBEntry &be, int type) {
+    const uint8_t *data = mapFile(be, type);
+    if (!data)
+        return false;
+
+    bool split = (type == TABLE_WDL) && (data[4] & 1);
+    data += 5;
+
+    int num = be.hasPawns ? 4 : 1;
+    uint64_t tbSize[4][2];
+    for (int t = 0; t < num; t++) {
+        EncInfo &ei = (type == TABLE_WDL) ? be.wdl[0][t] : be.dtz[t];
+        tbSize[t][0] = initEncInfo(ei, be, data, 0, t);
+        if (split)
+            tbSize[t][1] = initEncInfo(be.wdl[1][t], be, data, 4, t);
+        data += be.num + 1 + (be.hasPawns && be.pawns[1]);
+    }
+    data += (uintptr_t) data & 1;
+
+    uint64_t size[4][2][3];
+    for (int t = 0; t < num; t++) {
+        uint8_t flags;
+        EncInfo &ei = (type == TABLE_WDL) ? be.wdl[0][t] : be.dtz[t];
+        data = setupPairs(ei.precomp, data, tbSize[t][0], size[t][0], flags, type);
+        if (type == TABLE_DTZ)
+            be.dtzFlags[t] = flags;
+        if (split)
+            data = setupPairs(be.wdl[1][t].precomp, data, tbSize[t][1], size[t][1], flags, type);
+    }
+
+    // Map offsets are kept in bytes from the start of the maps
+    if (type == TABLE_DTZ) {
+        be.dtzMap = data;
+        for (int t = 0; t < num; t++) {
+            if (!(be.dtzFlags[t] & 2))
+                continue;
+            if (be.dtzFlags[t] & 16) {
+                data += (uintptr_t) data & 1;
+                for (int i = 0; i < 4; i++) {
+                    be.dtzMapIdx[t][i] = (uint32_t) (data + 2 - be.dtzMap);
+                    data += 2 + 2 * readLE16(data);
+                }
+            } else {
+                for (int i = 0; i < 4; i++) {
+                    be.dtzMapIdx[t][i] = (uint32_t) (data + 1 - be.dtzMap);
+                    data += 1 + data[0];
+                }
+            }
+        }
+        data += (uintptr_t) data & 1;
+    }
+
+    int sides = split ? 2 : 1;
+    for (int t = 0; t < num; t++) {
+        for (int i = 0; i < sides; i++) {
+            PairsData &d = (type == TABLE_WDL) ? be.wdl[i][t].precomp : be.dtz[t].precomp;
+            d.indexTable = data;
+            data += size[t][i][0];
+        }
+    }
+    for (int t = 0; t < num; t++) {
+        for (int i = 0; i < sides; i++) {
+            PairsData &d = (type == TABLE_WDL) ? be.wdl[i][t].precomp : be.dtz[t].precomp;
+            d.sizeTable = (const uint16_t *) data;
+            data += size[t][i][1];
+        }
+    }
+    for (int t = 0; t < num; t++) {
+        for (int i = 0; i < sides; i++) {
+            PairsData &d = (type == TABLE_WDL) ? be.wdl[i][t].precomp : be.dtz[t].precomp;
+            data = (const uint8_t *) (((uintptr_t) data + 0x3F) & ~(uintptr_t) 0x3F);
+            d.data = data;
+            data += size[t][i][2];
+        }
+    }
+    return true;
+}
+
+// Files are mapped at first access only; safe to call from several threads
+static bool isMapped(TBEntry &be, int type) {
+    if (be.ready[type].load(std::memory_order_acquire))
+        return be.mapping[type] != NULL;
+
+    std::lock_guard<std::mutex> lock(mapMutex);
+    if (!be.ready[type].load(std::memory_order_relaxed)) {
+        initTable(be, type);
+        be.ready[type].store(true, std::memory_order_release);
+    }
+    return be.mapping[type] != NULL;
+}
+
+// The sparse index gives the block and offset of every 2^idxBits-th value,
+// from which the block holding idx is found using the block sizes. Symbols
+// are then skipped until the one covering idx, which is expanded down to
+// the leaf holding the value.
+static int decompressPairs(PairsData &d, uint64_t idx) {
+    if (!d.idxBits)
+        return d.constValue;
+
+    uint64_t mainIdx = idx >> d.idxBits;
+    int litIdx = (int) (idx & ((1ULL << d.idxBits) - 1)) - (1 << (d.idxBits - 1));
+    uint32_t block = readLE32(d.indexTable + 6 * mainIdx);
+    litIdx += readLE16(d.indexTable + 6 * mainIdx + 4);
+
+    if (litIdx < 0) {
+        while (litIdx < 0)
+            litIdx += d.sizeTable[--block] + 1;
+    } else {
+        while (litIdx > d.sizeTable[block])
+            litIdx -= d.sizeTable[block++] + 1;
+    }
+
+    const uint8_t *ptr = d.data + ((uint64_t) block << d.blockSize);
+    uint64_t code = readBE64(ptr);
+    ptr += 8;
+    // Number of bits at the bottom of code already shifted out
+    int bitCnt = 0;
+    int sym;
+
+    while (true) {
+        int l = 0;
+        while (code < d.base[l])
+            l++;
+        sym = readLE16(d.offset + 2 * l) + (int) ((code - d.base[l]) >> (64 - d.minLen - l));
+        if (litIdx < d.symLen[sym] + 1)
+            break;
+        litIdx -= d.symLen[sym] + 1;
+        code <<= d.minLen + l;
+        bitCnt += d.minLen + l;
+        if (bitCnt >= 32) {
+            bitCnt -= 32;
+            code |= (uint64_t) readBE32(ptr) << bitCnt;
+            ptr += 4;
+        }
+    }
+
+    while (d.symLen[sym]) {
+        const uint8_t *w = d.symPat + 3 * sym;
+        int s1 = ((w[1] & 0xF) << 8) | w[0];
+        if (litIdx < d.symLen[s1] + 1) {
+            sym = s1;
+        } else {
+            litIdx -= d.symLen[s1] + 1;
+            sym = (w[2] << 4) | (w[1] >> 4);
+        }
+    }
+
+    const uint8_t *w = d.symPat + 3 * sym;
+    return ((w[1] & 0xF) << 8) | w[0];
+}
+
+// Writes the squares of the pieces of type pieces[i] into p from i on, with
+// the colours swapped if flip is set. Returns the index after them.
+static int fillSquares(Board &b, const uint8_t *pieces, bool flip, int mirror, int *p, int i) {
+    int colour = (pieces[i] >> 3) ^ (int) flip;
+    uint64_t bb = b.getPieces(colour, (pieces[i] & 7) - 1);
+    do {
+        p[i++] = bitScanForward(bb) ^ mirror;
+        bb &= bb - 1;
+    } while (bb);
+    return i;
+}
+
+// The leading pawn is the one nearest the a or h file, then the lowest,
+// and its file picks the table to probe
+static int leadingPawn(int *p, TBEntry &be) {
+    for (int i = 1; i < be.pawns[0]; i++)
+        if (FLAP[p[0]] > FLAP[p[i]])
+            std::swap(p[0], p[i]);
+    return FILE_TO_FILE[p[0] & 7];
+}
+
+// Each group of identical pieces is encoded as a combination of the squares
+// left free by the groups before it
+static uint64_t encodeGroups(int *p, EncInfo &ei, TBEntry &be, int k, uint64_t idx) {
+    while (k < be.num) {
+        int t = k + ei.norm[k];
+        std::sort(p + k, p + t);
+        uint64_t s = 0;
+        for (int i = k; i < t; i++) {
+            int skips = 0;
+            for (int j = 0; j < k; j++)
+                skips += (p[i] > p[j]);
+            s += binomial[i - k + 1][p[i] - skips];
+        }
+        idx += s * ei.factor[k];
+        k = t;
+    }
+    return idx;
+}
+
+// Pawnless positions are mapped so that the first piece lies in the
+// a1-d1-d4 triangle and the first leading piece off the diagonal is below
+// it
+static uint64_t encodePiece(int *p, EncInfo &ei, TBEntry &be) {
+    int n = be.num;
+    if (p[0] & 0x04)
+        for (int i = 0; i < n; i++)
+            p[i] ^= 0x07;
+    if (p[0] & 0x20)
+        for (int i = 0; i < n; i++)
+            p[i] ^= 0x38;
+
+    for (int i = 0; i < n; i++) {
+        if (OFF_DIAG[p[i]]) {
+            if (OFF_DIAG[p[i]] > 0 && i < (be.kkEnc ? 2 : 3))
+                for (int j = 0; j < n; j++)
+                    p[j] = flipDiag(p[j]);
+            break;
+        }
+    }
+
+    uint64_t idx;
+    int k;
+    if (be.kkEnc) {
+        idx = kkIdx[TRIANGLE[p[0]]][p[1]];
+        k = 2;
+    } else {
+        int s1 = (p[1] > p[0]);
+        int s2 = (p[2] > p[0]) + (p[2] > p[1]);
+        if (OFF_DIAG[p[0]])
+            idx = TRIANGLE[p[0]] * 63 * 62 + (p[1] - s1) * 62 + (p[2] - s2);
+        else if (OFF_DIAG[p[1]])
+            idx = 6 * 63 * 62 + DIAG[p[0]] * 28 * 62 + LOWER[p[1]] * 62 + p[2] - s2;
+        else if (OFF_DIAG[p[2]])
+            idx = 6 * 63 * 62 + 4 * 28 * 62 + DIAG[p[0]] * 7 * 28
+                + (DIAG[p[1]] - s1) * 28 + LOWER[p[2]];
+        else
+            idx = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28 + DIAG[p[0]] * 7 * 6
+                + (DIAG[p[1]] - s1) * 6 + (DIAG[p[2]] - s2);
+        k = 3;
+    }
+    return encodeGroups(p, ei, be, k, idx * ei.factor[0]);
+}
+
+// With pawns only left-right symmetry is used, putting the leading pawn on
+// the a-d files. Pawns of the other colour are confined to ranks 2-7.
+static uint64_t encodePawn(int *p, EncInfo &ei, TBEntry &be) {
+    if (p[0] & 0x04)
+        for (int i = 0; i < be.num; i++)
+            p[i] ^= 0x07;
+
+    int k = ei.norm[0];
+    for (int i = 1; i < k; i++)
+        for (int j = i + 1; j < k; j++)
+            if (PAWN_TWIST[p[i]] < PAWN_TWIST[p[j]])
+                std::swap(p[i], p[j]);
+
+    uint64_t idx = pawnIdx[k - 1][FLAP[p[0]]];
+    for (int i = 1; i < k; i++)
+        idx += binomial[k - i][PAWN_TWIST[p[i]]];
+    idx *= ei.factor[0];
+
+    if (be.pawns[1]) {
+        int t = k + ei.norm[k];
+        std::sort(p + k, p + t);
+        uint64_t s = 0;
+        for (int i = k; i < t; i++) {
+            int skips = 0;
+            for (int j = 0; j < k; j++)
+                skips += (p[i] > p[j]);
+            s += binomial[i - k + 1][p[i] - skips - 8];
+        }
+        idx += s * ei.factor[k];
+        k = t;
+    }
+    return encodeGroups(p, ei, be, k, idx);
+}
+
+// Looks the position up in a WDL table, or in a DTZ table given its WDL
+// value wdl. Tables are stored with the stronger side as white, so the
+// colours are swapped when black is stronger or, for symmetric material,
+// to move. A DTZ table only holds one side to move and sets result to
+// PROBE_CHANGE_STM for the other.
+static int probeTable(Board &b, int wdl, int &result, int type) {
+    if (type == TABLE_WDL && count(b.getOccupancy()) == 2)
+        return WDL_DRAW;
+
+    uint64_t key = materialKey(b);
+    std::unordered_map<uint64_t, TBEntry *>::iterator it = tbIndex.find(key);
+    if (it == tbIndex.end() || !isMapped(*it->second, type)) {
+        result = PROBE_FAIL;
+        return 0;
+    }
+    TBEntry &be = *it->second;
+
+    bool flip, bside;
+    if (!be.symmetric) {
+        flip = (key != be.key);
+        bside = ((b.getPlayerToMove() == WHITE) == flip);
+    } else {
+        flip = (b.getPlayerToMove() != WHITE);
+        bside = false;
+    }
+
+    int p[TB_MAX_PIECES];
+    uint64_t idx;
+    int t = 0;
+    EncInfo *ei;
+    if (!be.hasPawns) {
+        if (type == TABLE_DTZ && (be.dtzFlags[0] & 1) != bside && !be.symmetric) {
+            result = PROBE_CHANGE_STM;
+            return 0;
+        }
+        ei = (type == TABLE_WDL) ? &be.wdl[bside][0] : &be.dtz[0];
+        for (int i = 0; i < be.num;)
+            i = fillSquares(b, ei->pieces, flip, 0, p, i);
+        idx = encodePiece(p, *ei, be);
+    } else {
+        ei = (type == TABLE_WDL) ? &be.wdl[0][0] : &be.dtz[0];
+        int i = fillSquares(b, ei->pieces, flip, flip ? 0x38 : 0, p, 0);
+        t = leadingPawn(p, be);
+        if (type == TABLE_DTZ && (be.dtzFlags[t] & 1) != bside && !be.symmetric) {
+            result = PROBE_CHANGE_STM;
+            return 0;
+        }
+        ei = (type == TABLE_WDL) ? &be.wdl[bside][t] : &be.dtz[t];
+        while (i < be.num)
+            i = fillSquares(b, ei->pieces, flip, flip ? 0x38 : 0, p, i);
+        idx = encodePawn(p, *ei, be);
+    }
+
+    int v = decompressPairs(ei->precomp, idx);
+    if (type == TABLE_WDL)
+        return v - 2;
+
+    uint8_t flags = be.dtzFlags[t];
+    if (flags & 2) {
+        uint32_t m = be.dtzMapIdx[t][WDL_TO_MAP[wdl + 2]];
+        v = (flags & 16) ? readLE16(be.dtzMap + m + 2 * v) : be.dtzMap[m + v];
+    }
+    if (!(flags & PA_FLAGS[wdl + 2]) || (wdl & 1))
+        v *= 2;
+    return v;
+}
+
+// Tables store "don't care" values where the side to move has a winning
+// capture, so captures are resolved by a small alpha-beta search before
+// the position itself is probed. En passant captures are not in the tables
+// at all and are handled at the first level only.
+static int probeAB(Board &b, int alpha, int beta, int &result) {
+    int colour = b.getPlayerToMove();
+    ScoredMove buffer[MAX_MOVES];
+    ScoredMoveList moves(buffer);
+    b.getAllLegalMove(moves, colour);
+
+    for (unsigned int i = 0; i < moves.size(); i++) {
+        Move m = moves.get(i);
+        if (!isCapture(m))
+            continue;
+        Board copy = b.staticCopy();
+        copy.doMove(m, colour);
+        int v = -probeAB(copy, -beta, -alpha, result);
+        if (result == PROBE_FAIL)
+            return 0;
+        if (v > alpha) {
+            if (v >= beta)
+                return v;
+            alpha = v;
+        }
+    }
+
+    int v = probeTable(b, 0, result, TABLE_WDL);
+    return alpha >= v ? alpha : v;
+}
+
+void initTablebases(const std::string &paths) {
+    static bool indicesReady = false;
+    if (!indicesReady) {
+        initIndices();
+        indicesReady = true;
+    }
+
+    tbIndex.clear();
+    tbEntries.clear();
+    tbPaths.clear();
+    maxCardinality = 0;
+
+    if (paths.empty() || paths == "<empty>")
+        return;
+
+    std::stringstream ss(paths);
+    std::string path;
+    while (std::getline(ss, path, ':'))
+        if (!path.empty())
+            tbPaths.push_back(path);
+
+    for (unsigned int i = 0; i < tbPaths.size(); i++) {
+        DIR *dir = opendir(tbPaths[i].c_str());
+        if (!dir)
+            continue;
+
+        while (struct dirent *ent = readdir(dir)) {
+            std::string file = ent->d_name;
+            if (file.size() < 6 || file.compare(file.size() - 5, 5, TB_SUFFIX[TABLE_WDL]))
+                continue;
+            std::string name = file.substr(0, file.size() - 5);
+            if (name[0] != 'K' || name.find_first_not_of("KQRBNPv") != std::string::npos
+             || std::count(name.begin(), name.end(), 'v') != 1
+             || std::count(name.begin(), name.end(), 'K') != 2
+             || name[name.find('v') + 1] != 'K' || (int) name.size() - 1 > TB_MAX_PIECES)
+                continue;
+
+            tbEntries.emplace_back(name);
+            TBEntry *entry = &tbEntries.back();
+            if (tbIndex.count(entry->key)) {
+                tbEntries.pop_back();
+                continue;
+            }
+            tbIndex[entry->key] = entry;
+            tbIndex[entry->key2] = entry;
+            maxCardinality = std::max(maxCardinality, entry->num);
+        }
+        closedir(dir);
+    }
+
+    std::cout << "info string Found " << getTablebaseCount() << " tablebases" << std::endl;
+}
+
+int getTablebaseCount() {
+    return (int) tbEntries.size();
+}
+
+int getTablebaseCardinality() {
+    return std::min(maxCardinality, probeLimit);
+}
+
+void setTablebaseProbeLimit(int limit) {
+    probeLimit = std::max(0, std::min(limit, TB_MAX_PIECES));
+}
+
+int getTablebaseProbeLimit() {
+    return probeLimit;
+}
+
+// Sets result to PROBE_ZEROING_BEST_MOVE if a capture is the only way to
+// reach the returned value
+int probeWDL(Board &b, int &result) {
+    result = PROBE_OK;
+    int colour = b.getPlayerToMove();
+    ScoredMove buffer[MAX_MOVES];
+    ScoredMoveList moves(buffer);
+    b.getAllLegalMove(moves, colour);
+
+    // The best capture and, separately, the best en passant capture if it
+    // is better still
+    int bestCap = -3, bestEp = -3;
+    for (unsigned int i = 0; i < moves.size(); i++) {
+        Move m = moves.get(i);
+        if (!isCapture(m))
+            continue;
+        Board copy = b.staticCopy();
+        copy.doMove(m, colour);
+        int v = -probeAB(copy, WDL_LOSS, -bestCap, result);
+        if (result == PROBE_FAIL)
+            return 0;
+        if (v > bestCap) {
+            if (v == WDL_WIN) {
+                result = PROBE_ZEROING_BEST_MOVE;
+                return WDL_WIN;
+            }
+            if (!isEP(m))
+                bestCap = v;
+            else if (v > bestEp)
+                bestEp = v;
+        }
+    }
+
+    int v = probeTable(b, 0, result, TABLE_WDL);
+    if (result == PROBE_FAIL)
+        return 0;
+
+    if (bestEp > bestCap) {
+        if (bestEp > v) {
+            result = PROBE_ZEROING_BEST_MOVE;
+            return bestEp;
+        }
+        bestCap = bestEp;
+    }
+
+    if (bestCap >= v) {
+        result = (bestCap > WDL_DRAW) ? PROBE_ZEROING_BEST_MOVE : PROBE_OK;
+        return bestCap;
+    }
+
+    // The table scores stalemate without en passant rights as a draw, but
+    // if en passant is the only legal move it must be played
+    if (bestEp > -3 && v == WDL_DRAW && !b.isInCheck(colour)) {
+        unsigned int i = 0;
+        while (i < moves.size() && isEP(moves.get(i)))
+            i++;
+        if (i == moves.size()) {
+            result = PROBE_ZEROING_BEST_MOVE;
+            return bestEp;
+        }
+    }
+    return v;
+}
+
+// Returns the number of plies to a zeroing move (a capture, pawn move or
+// mate) with optimal play, signed by the outcome and 100 higher for
+// results spoilt by the fifty-move rule. Values read from tables that
+// store moves rather than plies may be one ply too high.
+int probeDTZ(Board &b, int &result) {
+    int wdl = probeWDL(b, result);
+    if (result == PROBE_FAIL || wdl == WDL_DRAW)
+        return 0;
+    if (result == PROBE_ZEROING_BEST_MOVE)
+        return WDL_TO_DTZ[wdl + 2];
+
+    int colour = b.getPlayerToMove();
+    ScoredMove buffer[MAX_MOVES];
+    ScoredMoveList moves(buffer);
+    b.getAllLegalMove(moves, colour);
+
+    // A winning pawn move zeroes the counter at once
+    if (wdl > 0) {
+        for (unsigned int i = 0; i < moves.size(); i++) {
+            Move m = moves.get(i);
+            if (isCapture(m) || b.getPieceOnSquare(colour, getStartSq(m)) != PAWNS)
+                continue;
+            Board copy = b.staticCopy();
+            copy.doMove(m, colour);
+            int v = -probeWDL(copy, result);
+            if (result == PROBE_FAIL)
+                return 0;
+            if (v == wdl)
+                return WDL_TO_DTZ[wdl + 2];
+        }
+    }
+
+    result = PROBE_OK;
+    int dtz = probeTable(b, wdl, result, TABLE_DTZ);
+    if (result == PROBE_FAIL)
+        return 0;
+    if (result != PROBE_CHANGE_STM)
+        return WDL_TO_DTZ[wdl + 2] + (wdl > 0 ? dtz : -dtz);
+
+    // The table is for the other side to move, so take the best reply. A
+    // losing side's captures and pawn moves count as zeroing in one ply.
+    int best = (wdl > 0) ? INT_MAX : WDL_TO_DTZ[wdl + 2];
+    for (unsigned int i = 0; i < moves.size(); i++) {
+        Move m = moves.get(i);
+        if (isCapture(m) || b.getPieceOnSquare(colour, getStartSq(m)) == PAWNS)
+            continue;
+        Board copy = b.staticCopy();
+        copy.doMove(m, colour);
+        int v = -probeDTZ(copy, result);
+        if (result == PROBE_FAIL)
+            return 0;
+        if (v == 1 && isMate(copy))
+            best = 1;
+        else if (wdl > 0 && v > 0 && v + 1 < best)
+            best = v + 1;
+        else if (wdl < 0 && v - 1 < best)
+            best = v - 1;
+    }
+    result = PROBE_OK;
+    return best;
+}
+
+bool probeRootDTZ(Board &b, ScoredMoveList &rootMoves, int &rank) {
+    int colour = b.getPlayerToMove();
+    int cnt50 = b.getFiftyMoveCounter();
+    int result = PROBE_OK;
+    int bestRank = -1001;
+
+    for (unsigned int i = 0; i < rootMoves.size(); i++) {
+        Move m = rootMoves.get(i);
+        Board copy = b.staticCopy();
+        copy.doMove(m, colour);
+
+        // DTZ counted from the root, which a zeroing move resets
+        int v;
+        if (copy.getFiftyMoveCounter() == 0) {
+            v = WDL_TO_DTZ[-probeWDL(copy, result) + 2];
+        } else {
+            v = -probeDTZ(copy, result);
+            v = v > 0 ? v + 1 : v < 0 ? v - 1 : 0;
+        }
+        if (v == 2 && isMate(copy))
+            v = 1;
+
+        if (result == PROBE_FAIL)
+            return false;
+
+        // Wins within the fifty-move limit rank equally, as do losses that
+        // cannot be saved by it
+        int r = v > 0 ? (v + cnt50 <= 99 ? 1000 : 1000 - (v + cnt50))
+              : v < 0 ? (-v * 2 + cnt50 < 100 ? -1000 : -1000 + (-v + cnt50))
+              : 0;
+        rootMoves.setScore(i, r);
+        bestRank = std::max(bestRank, r);
+    }
+
+    unsigned int kept = 0;
+    for (unsigned int i = 0; i < rootMoves.size(); i++) {
+        if (rootMoves.getScore(i) == bestRank) {
+            rootMoves.swap(kept, i);
+            kept++;
+        }
+    }
+    rootMoves.resize(kept);
+    rank = bestRank;
+    return true;
+}
+
+struct KnownValue {
+    const char *fen;
+    int wdl;
+    int dtz;
+};
+
+// Worked out by retrograde analysis of every position of the three-man
+// endings: the longest wins, mates, stalemates and captures into KvK. The
+// five-man positions are a mate in one, a mate and a stalemate, which need
+// no analysis but do exercise the larger index schemes.
+static const KnownValue KNOWN_VALUES[] = {
+    {"8/8/8/5k2/8/8/1Q6/K7 w - - 0 1", WDL_WIN, 19},
+    {"8/8/8/8/4k3/8/1Q6/K7 b - - 0 1", WDL_LOSS, -20},
+    {"8/8/8/8/8/8/8/K1kQ4 b - - 0 1", WDL_DRAW, 0},
+    {"8/8/8/8/8/8/4Q3/K1k5 b - - 0 1", WDL_DRAW, 0},
+    {"8/8/8/8/8/8/8/kQK5 b - - 0 1", WDL_LOSS, -1},
+    {"8/8/8/8/8/8/8/k1KQ4 w - - 0 1", WDL_WIN, 1},
+    {"8/8/8/8/8/8/Q7/K1k5 w - - 0 1", WDL_WIN, 7},
+    {"8/8/8/8/8/2k5/1R6/K7 w - - 0 1", WDL_WIN, 31},
+    {"8/8/8/8/8/8/1Rk5/K7 b - - 0 1", WDL_LOSS, -32},
+    {"8/8/8/8/8/8/8/K1kR4 b - - 0 1", WDL_DRAW, 0},
+    {"8/8/8/8/8/8/1R6/k1K5 b - - 0 1", WDL_DRAW, 0},
+    {"8/8/8/8/8/R7/8/k1K5 b - - 0 1", WDL_LOSS, -1},
+    {"8/8/8/8/8/1R6/8/k1K5 w - - 0 1", WDL_WIN, 1},
+    {"8/8/8/8/8/8/8/1k1KR3 w - - 0 1", WDL_WIN, 7},
+    {"8/8/8/k7/8/8/K4P2/8 w - - 0 1", WDL_WIN, 19},
+    {"8/8/8/k7/8/K7/6P1/8 b - - 0 1", WDL_LOSS, -20},
+    {"8/8/8/8/8/8/2P5/K1k5 b - - 0 1", WDL_DRAW, 0},
+    {"k7/P7/K7/8/8/8/8/8 b - - 0 1", WDL_DRAW, 0},
+    {"8/8/8/8/8/k7/P7/K7 w - - 0 1", WDL_DRAW, 0},
+    {"8/8/8/8/8/k7/4P3/2K5 w - - 0 1", WDL_WIN, 7},
+    {"7k/8/6K1/8/8/8/1r6/3Q4 w - - 0 1", WDL_WIN, 1},
+    {"3Q3k/8/6K1/8/8/8/1r6/8 b - - 0 1", WDL_LOSS, -1},
+    {"k7/p7/P1K5/4B3/8/8/8/8 b - - 0 1", WDL_DRAW, 0},
+};
+
+// The same position with the colours swapped, which has the same values
+static std::string flipFen(const std::string &fen) {
+    std::istringstream stream(fen);
+    std::string placement, stm, rest;
+    stream >> placement >> stm;
+    std::getline(stream, rest);
+
+    std::vector<std::string> ranks;
+    std::stringstream ss(placement);
+    std::string rank;
+    while (std::getline(ss, rank, '/'))
+        ranks.push_back(rank);
+
+    std::string flipped;
+    for (int i = (int) ranks.size() - 1; i >= 0; i--) {
+        for (char c : ranks[i])
+            flipped += std::isalpha(c) ? (char) (std::islower(c) ? std::toupper(c) : std::tolower(c)) : c;
+        if (i)
+            flipped += '/';
+    }
+    return flipped + (stm == "w" ? " b" : " w") + rest;
+}
+
+int runTablebaseCheck(const std::string &paths) {
+    initTablebases(paths);
+    int checked = 0, missing = 0, wrong = 0;
+    for (const KnownValue &known : KNOWN_VALUES) {
+        for (int flip = 0; flip < 2; flip++) {
+            std::string fen = flip ? flipFen(known.fen) : std::string(known.fen);
+            Board b = fenToBoard(fen);
+            int wdlResult = PROBE_OK, dtzResult = PROBE_OK;
+            int wdl = probeWDL(b, wdlResult);
+            int dtz = probeDTZ(b, dtzResult);
+            if (wdlResult == PROBE_FAIL || dtzResult == PROBE_FAIL) {
+                missing++;
+                continue;
+            }
+            checked++;
+            // Tables may store DTZ in moves, rounding odd distances up a ply
+            bool dtzOk = dtz == known.dtz
+                      || (known.dtz > 1 && dtz == known.dtz + 1)
+                      || (known.dtz < -1 && dtz == known.dtz - 1);
+            if (wdl != known.wdl || !dtzOk) {
+                wrong++;
+                std::cout << fen << ": wdl " << wdl << " dtz " << dtz << ", expected wdl "
+                          << known.wdl << " dtz " << known.dtz << std::endl;
+            }
+        }
+    }
+    std::cout << "checked " << checked << " positions, " << wrong << " wrong, "
+              << missing << " without tables" << std::endl;
+    return (wrong || !checked) ? 1 : 0;
+}
@@ -0,0 +1,42 @@
+#ifndef __SYZYGY_H__
+#define __SYZYGY_H__
+
+#include "board.h"
+#include <string>
+
+const int TB_MAX_PIECES = 7;
+
+// WDL values, from the side to move's point of view. Cursed wins and
+// blessed losses are decisive but drawn under the fifty-move rule.
+const int WDL_LOSS = -2;
+const int WDL_BLESSED_LOSS = -1;
+const int WDL_DRAW = 0;
+const int WDL_CURSED_WIN = 1;
+const int WDL_WIN = 2;
+
+const int PROBE_CHANGE_STM = -1;
+const int PROBE_FAIL = 0;
+const int PROBE_OK = 1;
+const int PROBE_ZEROING_BEST_MOVE = 2;
+
+// Scans each directory in paths (separated by ':') for .rtbw files. Tables
+// are only memory mapped the first time a position probes them.
+void initTablebases(const std::string &paths);
+int getTablebaseCount();
+int getTablebaseCardinality();
+void setTablebaseProbeLimit(int limit);
+int getTablebaseProbeLimit();
+
+int probeWDL(Board &b, int &result);
+int probeDTZ(Board &b, int &result);
+// Keeps only the root moves which preserve the best DTZ outcome and sets
+// rank to 1000 for certain wins, -1000 for certain losses, in between for
+// results affected by the fifty-move rule.
+bool probeRootDTZ(Board &b, ScoredMoveList &rootMoves, int &rank);
+
+// Probes known KQvK, KRvK, KPvK, KQvKR and KBPvKP positions, both ways
+// round, against the tables in paths and prints any WDL or DTZ value that
+// differs
+int runTablebaseCheck(const std::string &paths);
+
+#endif
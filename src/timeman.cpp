@@ -0,0 +1,108 @@
+#include "timeman.h"
+#include <algorithm>
+
+static int moveOverhead = DEFAULT_MOVE_OVERHEAD;
+
+// Horizon assumed when the GUI does not send movestogo
+const int DEFAULT_MOVES_TO_GO = 40;
+const int MAX_MOVES_TO_GO = 50;
+// How far the hard limit may stretch past the optimum
+const int MAX_TIME_RATIO = 5;
+// Stop after an iteration once this fraction of the soft limit is used,
+// since the next iteration is unlikely to finish in the remaining time
+const double ITERATION_START_RATIO = 0.6;
+// Scale for best move stability, indexed by consecutive unchanged iterations
+const double STABILITY_SCALE[6] = {1.35, 1.15, 1.0, 0.9, 0.8, 0.7};
+
+TimeManager::TimeManager() {
+    startTime = ChessClock::now();
+    managed = false;
+    optimumTime = maximumTime = 0;
+    lastBestMove = NULL_MOVE;
+    lastScore = 0;
+    bestMoveStability = 0;
+    scoreDropScale = 1.0;
+}
+
+void TimeManager::init(const SearchLimits &limits, int colour) {
+    startTime = ChessClock::now();
+    lastBestMove = NULL_MOVE;
+    lastScore = -INFTY;
+    bestMoveStability = 0;
+    scoreDropScale = 1.0;
+
+    if (limits.moveTime) {
+        managed = false;
+        optimumTime = maximumTime = std::max<int64_t>(1,
+            (int64_t) limits.moveTime - moveOverhead);
+        return;
+    }
+    if (limits.infinite || !limits.time[colour]) {
+        managed = false;
+        optimumTime = maximumTime = UINT64_MAX;
+        return;
+    }
+
+    managed = true;
+    int64_t time = (int64_t) limits.time[colour];
+    int64_t inc = (int64_t) limits.inc[colour];
+    int movesToGo = limits.movesToGo ? std::min(limits.movesToGo, MAX_MOVES_TO_GO)
+                                     : DEFAULT_MOVES_TO_GO;
+
+    // Every move we will make before the next time control costs us the
+    // overhead, not just this one
+    int64_t available = time + inc * (movesToGo - 1)
+                      - (int64_t) moveOverhead * (movesToGo + 1);
+    available = std::max<int64_t>(1, available);
+    int64_t hardCap = std::max<int64_t>(1, time - moveOverhead);
+
+    int64_t optimum = available / movesToGo;
+    int64_t maximum = optimum * MAX_TIME_RATIO;
+    if (movesToGo == 1)
+        maximum = std::min(maximum, hardCap * 9 / 10);
+    else
+        maximum = std::min(maximum, hardCap * 3 / 10);
+
+    maximumTime = (uint64_t) std::max<int64_t>(1, maximum);
+    optimumTime = (uint64_t) std::max<int64_t>(1, std::min(optimum, maximum));
+}
+
+void TimeManager::update(Move bestMove, int score) {
+    if (bestMove == lastBestMove)
+        bestMoveStability = std::min(bestMoveStability + 1, 5);
+    else
+        bestMoveStability = 0;
+
+    scoreDropScale = 1.0;
+    if (lastScore != -INFTY && score < lastScore) {
+        int drop = std::min(lastScore - score, 200);
+        scoreDropScale = 1.0 + drop / 250.0;
+    }
+
+    lastBestMove = bestMove;
+    lastScore = score;
+}
+
+bool TimeManager::stopAfterIteration() const {
+    if (!managed)
+        return false;
+    double softLimit = optimumTime * STABILITY_SCALE[bestMoveStability] * scoreDropScale;
+    softLimit = std::min(softLimit, (double) maximumTime);
+    return elapsed() >= softLimit * ITERATION_START_RATIO;
+}
+
+bool TimeManager::outOfTime() const {
+    return elapsed() >= maximumTime;
+}
+
+uint64_t TimeManager::elapsed() const {
+    return getTimeElapsed(startTime);
+}
+
+void TimeManager::setMoveOverhead(int overhead) {
+    moveOverhead = std::max(0, std::min(overhead, MAX_MOVE_OVERHEAD));
+}
+
+int TimeManager::getMoveOverhead() {
+    return moveOverhead;
+}
@@ -0,0 +1,60 @@
+#ifndef __TIMEMAN_H__
+#define __TIMEMAN_H__
+
+#include "common.h"
+
+// The clock is only read once every TIME_CHECK_INTERVAL nodes
+const uint64_t TIME_CHECK_INTERVAL = 1024;
+
+const int DEFAULT_MOVE_OVERHEAD = 10;
+const int MAX_MOVE_OVERHEAD = 5000;
+
+struct SearchLimits {
+    uint64_t time[2];
+    uint64_t inc[2];
+    int movesToGo;
+    uint64_t moveTime;
+    int depth;
+    uint64_t nodes;
+    bool infinite;
+
+    SearchLimits() {
+        time[WHITE] = time[BLACK] = 0;
+        inc[WHITE] = inc[BLACK] = 0;
+        movesToGo = 0;
+        moveTime = 0;
+        depth = MAX_DEPTH;
+        nodes = 0;
+        infinite = false;
+    }
+};
+
+class TimeManager {
+public:
+    TimeManager();
+
+    void init(const SearchLimits &limits, int colour);
+    void update(Move bestMove, int score);
+
+    bool isManaged() const { return managed; }
+    bool stopAfterIteration() const;
+    bool outOfTime() const;
+    uint64_t elapsed() const;
+    uint64_t getOptimumTime() const { return optimumTime; }
+    uint64_t getMaximumTime() const { return maximumTime; }
+
+    static void setMoveOverhead(int overhead);
+    static int getMoveOverhead();
+
+private:
+    ChessTime startTime;
+    bool managed;
+    uint64_t optimumTime;
+    uint64_t maximumTime;
+    Move lastBestMove;
+    int lastScore;
+    int bestMoveStability;
+    double scoreDropScale;
+};
+
+#endif
@@ -0,0 +1,566 @@
+#include "tune.h"
+#include <iostream>
+
+#ifndef TUNE
+int runTune(int, char **) {
+    std::cout << "Tuning not compiled in, rebuild with make TUNE=1" << std::endl;
+    return 1;
+}
+#else
+#include "eval.h"
+#include "packed.h"
+#include "uci.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Lines are read in chunks which all threads resolve in parallel
+const int TUNE_CHUNK_LINES = 1 << 16;
+const int TUNE_QS_PLIES = 16;
+const int K_SEARCH_ITERATIONS = 40;
+const int REPORT_EPOCHS = 10;
+
+// One traced term of a position: how many more times white applied it
+// than black
+struct TuneEntry {
+    uint16_t term;
+    int16_t count;
+};
+
+// A quiesced position. The fixed halves hold everything that is not tuned,
+// such as king danger, so that the model reproduces evaluate() exactly with
+// the starting weights.
+struct TunePosition {
+    uint32_t first;
+    uint16_t length;
+    uint8_t phase;
+    uint8_t scale;
+    float result;
+    float fixedMg;
+    float fixedEg;
+    float tempo;
+};
+
+// Each thread keeps the positions it loaded and evaluates them in every pass
+struct TuneShard {
+    std::vector<TunePosition> positions;
+    std::vector<TuneEntry> entries;
+    Eval evaluator;
+    double loss;
+    double gradient[NUM_TUNE_TERMS][2];
+};
+
+struct TuneOptions {
+    std::string input;
+    int epochs;
+    int threads;
+    double rate;
+    bool coordinateDescent;
+};
+
+static bool parseOptions(int argc, char **argv, TuneOptions &options) {
+    options.epochs = DEFAULT_TUNE_EPOCHS;
+    options.threads = std::max(1, (int) std::thread::hardware_concurrency());
+    options.rate = DEFAULT_TUNE_RATE;
+    options.coordinateDescent = false;
+    bool valid = true;
+    for (int i = 0; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        std::string value = argv[i + 1];
+        if (option == "--input") options.input = value;
+        else if (option == "--epochs") valid &= parseNumber(value, options.epochs);
+        else if (option == "--threads") valid &= parseNumber(value, options.threads);
+        else if (option == "--rate") valid &= parseNumber(value, options.rate);
+        else if (option == "--method") options.coordinateDescent = (value == "cd");
+        else {
+            std::cout << "Unknown option " << option << std::endl;
+            return false;
+        }
+    }
+    options.threads = std::max(1, options.threads);
+    if (!valid || argc % 2 != 0 || options.input.empty()) {
+        std::cout << "Usage: brahma tune --input FILE [--epochs N] [--threads N]"
+                  << " [--rate X] [--method gd|cd]" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Splits a line into a FEN, completing EPD positions with move counters, and
+// the result from white's point of view
+static bool parseLine(const std::string &line, std::string &fen, float &result) {
+    std::istringstream stream(line);
+    std::string field;
+    fen.clear();
+    int fields = 0;
+    // The result starts at the first token which is not a move counter, or
+    // after the sixth field. tellg() is -1 once the line is used up.
+    size_t restStart = line.size();
+    while (fields < 6) {
+        std::streamoff start = stream.tellg();
+        if (!(stream >> field))
+            break;
+        if (fields >= 4 && field.find_first_not_of("0123456789") != std::string::npos) {
+            restStart = (size_t) start;
+            break;
+        }
+        fen += (fields ? " " : "") + field;
+        fields++;
+    }
+    if (fields < 4)
+        return false;
+    if (fields == 4)
+        fen += " 0 1";
+    if (fields == 6 && stream.tellg() >= 0)
+        restStart = (size_t) stream.tellg();
+
+    std::string rest = line.substr(restStart);
+    size_t bracket = rest.find('[');
+    if (rest.find("1/2-1/2") != std::string::npos)
+        result = 0.5f;
+    else if (rest.find("1-0") != std::string::npos)
+        result = 1.0f;
+    else if (rest.find("0-1") != std::string::npos)
+        result = 0.0f;
+    else if (bracket != std::string::npos)
+        result = (float) std::atof(rest.c_str() + bracket + 1);
+    else
+        return false;
+    return result >= 0.0f && result <= 1.0f;
+}
+
+// Plain capture search which also returns the position it stands pat in, so
+// that only quiet positions are traced
+static int quiesce(Eval &evaluator, Board &b, int ply, int alpha, int beta, Board &leaf) {
+    int colour = b.getPlayerToMove();
+    bool inCheck = b.isInCheck(colour);
+    leaf = b;
+    if (!inCheck) {
+        int standPat = evaluator.evaluate(b);
+        if (standPat >= beta || ply >= TUNE_QS_PLIES)
+            return standPat;
+        alpha = std::max(alpha, standPat);
+    }
+
+    ScoredMove buffer[MAX_MOVES];
+    ScoredMoveList moves(buffer);
+    if (inCheck)
+        b.getAllPseudoLegalMoves(moves, colour);
+    else
+        b.getPseudoLegalCaptures(moves, colour, true);
+
+    // Most valuable victim, least valuable attacker first
+    for (unsigned int i = 0; i < moves.size(); i++) {
+        Move m = moves.get(i);
+        int victim = isEP(m) ? PAWNS : b.getPieceOnSquare(1 - colour, getEndSq(m));
+        int attacker = b.getPieceOnSquare(colour, getStartSq(m));
+        moves.setScore(i, (victim >= 0) ? 8 * victim + KINGS - attacker : 0);
+    }
+
+    bool anyLegal = false;
+    for (unsigned int i = 0; i < moves.size(); i++) {
+        Move m = moves.pickBest(i);
+        if (!inCheck && !b.seeGE(m, 0))
+            continue;
+        Board copy = b.staticCopy();
+        if (!copy.doPseudoLegalMove(m, colour))
+            continue;
+        anyLegal = true;
+        Board childLeaf;
+        int score = -quiesce(evaluator, copy, ply + 1, -beta, -alpha, childLeaf);
+        if (score > alpha) {
+            alpha = score;
+            leaf = childLeaf;
+            if (score >= beta)
+                break;
+        }
+    }
+    if (inCheck && !anyLegal)
+        return -MATE_SCORE + ply;
+    return alpha;
+}
+
+static void loadPosition(TuneShard &shard, Board &b, float result, const int (*start)[2]) {
+    Board leaf;
+    quiesce(shard.evaluator, b, 0, -INFTY, INFTY, leaf);
+    if (leaf.isInCheck(leaf.getPlayerToMove()))
+        return;
+    shard.evaluator.evaluate(leaf);
+
+    TunePosition p;
+    p.first = (uint32_t) shard.entries.size();
+    double linearMg = 0, linearEg = 0;
+    for (int term = 0; term < NUM_TUNE_TERMS; term++) {
+        int count = evalTrace.counts[term][WHITE] - evalTrace.counts[term][BLACK];
+        if (!count)
+            continue;
+        TuneEntry entry;
+        entry.term = (uint16_t) term;
+        entry.count = (int16_t) count;
+        shard.entries.push_back(entry);
+        linearMg += count * start[term][0];
+        linearEg += count * start[term][1];
+    }
+    p.length = (uint16_t) (shard.entries.size() - p.first);
+    p.phase = (uint8_t) evalTrace.phase;
+    p.scale = (uint8_t) evalTrace.scale;
+    p.result = result;
+    p.fixedMg = (float) (decEvalMg(evalTrace.score) - linearMg);
+    p.fixedEg = (float) (decEvalEg(evalTrace.score) - linearEg);
+    p.tempo = (float) ((leaf.getPlayerToMove() == WHITE) ? TEMPO : -TEMPO);
+    shard.positions.push_back(p);
+}
+
+static void loadLine(TuneShard &shard, const std::string &line, const int (*start)[2]) {
+    std::string fen;
+    float result = 0;
+    if (!parseLine(line, fen, result))
+        return;
+    Board b = fenToBoard(fen);
+    loadPosition(shard, b, result, start);
+}
+
+// Packed files are mapped whole, so the threads can share them out directly
+static uint64_t loadPackedPositions(const std::string &path, std::vector<TuneShard *> &shards,
+        const int (*start)[2]) {
+    PackedReader reader;
+    if (!reader.open(path)) {
+        std::cout << "Cannot open " << path << std::endl;
+        return 0;
+    }
+
+    int threads = (int) shards.size();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.push_back(std::thread([&, t]() {
+            for (uint64_t i = t; i < reader.size(); i += threads) {
+                Board b;
+                if (unpackPosition(reader.get(i), b))
+                    loadPosition(*shards[t], b, reader.get(i).result / 2.0f, start);
+            }
+        }));
+    }
+    for (std::thread &worker : workers)
+        worker.join();
+    return reader.size();
+}
+
+static uint64_t loadPositions(const std::string &path, std::vector<TuneShard *> &shards,
+        const int (*start)[2]) {
+    if (isPackedFile(path))
+        return loadPackedPositions(path, shards, start);
+    std::ifstream file(path);
+    if (!file) {
+        std::cout << "Cannot open " << path << std::endl;
+        return 0;
+    }
+
+    std::vector<std::string> lines;
+    uint64_t total = 0;
+    int threads = (int) shards.size();
+    while (true) {
+        lines.clear();
+        std::string line;
+        while ((int) lines.size() < TUNE_CHUNK_LINES && std::getline(file, line))
+            lines.push_back(line);
+        if (lines.empty())
+            break;
+        total += lines.size();
+
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; t++) {
+            workers.push_back(std::thread([&, t]() {
+                for (size_t i = t; i < lines.size(); i += threads)
+                    loadLine(*shards[t], lines[i], start);
+            }));
+        }
+        for (std::thread &worker : workers)
+            worker.join();
+    }
+    return total;
+}
+
+static double sigmoid(double k, double eval) {
+    return 1.0 / (1.0 + std::pow(10.0, -k * eval / 400.0));
+}
+
+static double modelEval(const TunePosition &p, const TuneEntry *entries, const double (*weights)[2]) {
+    double mg = p.fixedMg, eg = p.fixedEg;
+    for (int i = 0; i < p.length; i++) {
+        mg += entries[i].count * weights[entries[i].term][0];
+        eg += entries[i].count * weights[entries[i].term][1];
+    }
+    return (mg * p.phase + eg * p.scale / 64.0 * (MAX_PHASE - p.phase)) / MAX_PHASE + p.tempo;
+}
+
+static void shardPass(TuneShard &shard, const double (*weights)[2], double k, bool gradient) {
+    shard.loss = 0;
+    if (gradient) {
+        for (int term = 0; term < NUM_TUNE_TERMS; term++)
+            shard.gradient[term][0] = shard.gradient[term][1] = 0;
+    }
+
+    for (const TunePosition &p : shard.positions) {
+        const TuneEntry *entries = &shard.entries[p.first];
+        double s = sigmoid(k, modelEval(p, entries, weights));
+        double error = p.result - s;
+        shard.loss += error * error;
+        if (!gradient)
+            continue;
+
+        double slope = -2.0 * error * s * (1.0 - s) * k * std::log(10.0) / 400.0;
+        double mgSlope = slope * p.phase / MAX_PHASE;
+        double egSlope = slope * (MAX_PHASE - p.phase) / MAX_PHASE * p.scale / 64.0;
+        for (int i = 0; i < p.length; i++) {
+            shard.gradient[entries[i].term][0] += mgSlope * entries[i].count;
+            shard.gradient[entries[i].term][1] += egSlope * entries[i].count;
+        }
+    }
+}
+
+// Mean squared error over every position, with the gradient summed into
+// gradient when it is not null
+static double runPass(std::vector<TuneShard *> &shards, const double (*weights)[2], double k,
+        double (*gradient)[2]) {
+    std::vector<std::thread> workers;
+    for (TuneShard *shard : shards)
+        workers.push_back(std::thread(shardPass, std::ref(*shard), weights, k, gradient != nullptr));
+    for (std::thread &worker : workers)
+        worker.join();
+
+    double loss = 0;
+    uint64_t positions = 0;
+    for (TuneShard *shard : shards) {
+        loss += shard->loss;
+        positions += shard->positions.size();
+        if (!gradient)
+            continue;
+        for (int term = 0; term < NUM_TUNE_TERMS; term++) {
+            gradient[term][0] += shard->gradient[term][0];
+            gradient[term][1] += shard->gradient[term][1];
+        }
+    }
+    if (gradient) {
+        for (int term = 0; term < NUM_TUNE_TERMS; term++) {
+            gradient[term][0] /= positions;
+            gradient[term][1] /= positions;
+        }
+    }
+    return loss / positions;
+}
+
+// Golden section search for the sigmoid scale that best fits the current
+// evaluation to the results
+static double fitK(std::vector<TuneShard *> &shards, const double (*weights)[2]) {
+    const double ratio = (std::sqrt(5.0) - 1.0) / 2.0;
+    double low = 0.0, high = 4.0;
+    double a = high - ratio * (high - low), b = low + ratio * (high - low);
+    double lossA = runPass(shards, weights, a, nullptr);
+    double lossB = runPass(shards, weights, b, nullptr);
+    for (int i = 0; i < K_SEARCH_ITERATIONS; i++) {
+        if (lossA < lossB) {
+            high = b;
+            b = a;
+            lossB = lossA;
+            a = high - ratio * (high - low);
+            lossA = runPass(shards, weights, a, nullptr);
+        } else {
+            low = a;
+            a = b;
+            lossA = lossB;
+            b = low + ratio * (high - low);
+            lossB = runPass(shards, weights, b, nullptr);
+        }
+    }
+    return (low + high) / 2;
+}
+
+static void getTunable(bool (*tunable)[2]) {
+    for (int g = 0; g < NUM_TUNE_GROUPS; g++) {
+        const TuneGroup &group = TUNE_GROUPS[g];
+        for (int i = group.start; i < group.start + group.count; i++) {
+            tunable[i][0] = group.format != TUNE_FORMAT_EG;
+            tunable[i][1] = group.format != TUNE_FORMAT_MG;
+        }
+    }
+}
+
+static void gradientDescent(std::vector<TuneShard *> &shards, double (*weights)[2],
+        double k, const TuneOptions &options, ChessTime startTime) {
+    const double beta1 = 0.9, beta2 = 0.999, epsilon = 1e-8;
+    static double moment[NUM_TUNE_TERMS][2], velocity[NUM_TUNE_TERMS][2];
+    static double gradient[NUM_TUNE_TERMS][2];
+    static bool tunable[NUM_TUNE_TERMS][2];
+    getTunable(tunable);
+
+    for (int epoch = 1; epoch <= options.epochs; epoch++) {
+        for (int term = 0; term < NUM_TUNE_TERMS; term++)
+            gradient[term][0] = gradient[term][1] = 0;
+        double loss = runPass(shards, weights, k, gradient);
+
+        double correction1 = 1.0 - std::pow(beta1, epoch);
+        double correction2 = 1.0 - std::pow(beta2, epoch);
+        for (int term = 0; term < NUM_TUNE_TERMS; term++) {
+            for (int half = 0; half < 2; half++) {
+                if (!tunable[term][half])
+                    continue;
+                double g = gradient[term][half];
+                moment[term][half] = beta1 * moment[term][half] + (1 - beta1) * g;
+                velocity[term][half] = beta2 * velocity[term][half] + (1 - beta2) * g * g;
+                weights[term][half] -= options.rate * (moment[term][half] / correction1)
+                                     / (std::sqrt(velocity[term][half] / correction2) + epsilon);
+            }
+        }
+
+        if (epoch % REPORT_EPOCHS == 0 || epoch == options.epochs)
+            std::printf("epoch %d loss %.8f time %llus\n", epoch, loss,
+                (unsigned long long) getTimeElapsed(startTime) / 1000);
+    }
+}
+
+// Integer steps on one weight at a time, kept while the loss improves. Much
+// slower than gradient descent but cannot overshoot.
+static void coordinateDescent(std::vector<TuneShard *> &shards, double (*weights)[2],
+        double k, const TuneOptions &options, ChessTime startTime) {
+    static bool tunable[NUM_TUNE_TERMS][2];
+    getTunable(tunable);
+    for (int term = 0; term < NUM_TUNE_TERMS; term++)
+        weights[term][0] = std::round(weights[term][0]), weights[term][1] = std::round(weights[term][1]);
+
+    double best = runPass(shards, weights, k, nullptr);
+    for (int sweep = 1; sweep <= options.epochs; sweep++) {
+        bool improved = false;
+        for (int term = 0; term < NUM_TUNE_TERMS; term++) {
+            for (int half = 0; half < 2; half++) {
+                if (!tunable[term][half])
+                    continue;
+                for (int step : {1, -2}) {
+                    weights[term][half] += step;
+                    double loss = runPass(shards, weights, k, nullptr);
+                    if (loss < best) {
+                        best = loss;
+                        improved = true;
+                        break;
+                    }
+                    if (step < 0)
+                        weights[term][half] += 1;
+                }
+            }
+        }
+        std::printf("sweep %d loss %.8f time %llus\n", sweep, best,
+            (unsigned long long) getTimeElapsed(startTime) / 1000);
+        if (!improved)
+            break;
+    }
+}
+
+static void printValues(const double (*weights)[2], int start, int count, int half, int perLine) {
+    for (int i = 0; i < count; i++) {
+        if (i % perLine == 0)
+            std::printf("\n   ");
+        std::printf(" %4d%s", (int) std::round(weights[start + i][half]), (i + 1 < count) ? "," : "");
+    }
+}
+
+// Prints the weights in the layout of the declarations in eval.cpp
+static void printWeights(const double (*weights)[2]) {
+    for (int g = 0; g < NUM_TUNE_GROUPS; g++) {
+        const TuneGroup &group = TUNE_GROUPS[g];
+        if (group.format == TUNE_FORMAT_SPLIT) {
+            for (int half = 0; half < 2; half++) {
+                const char *suffix = half ? "EG" : "MG";
+                if (group.count > 64) {
+                    std::printf("const int %s_%s[%d][64] = {", group.name, suffix, group.count / 64);
+                    for (int table = 0; table < group.count / 64; table++) {
+                        std::printf("\n{");
+                        printValues(weights, group.start + table * 64, 64, half, 8);
+                        std::printf("\n}%s", (table + 1 < group.count / 64) ? "," : "");
+                    }
+                    std::printf("\n};\n");
+                } else {
+                    std::printf("const int %s_%s[%d] = {", group.name, suffix, group.count);
+                    printValues(weights, group.start, group.count, half, 8);
+                    std::printf("\n};\n");
+                }
+            }
+        } else if (group.format == TUNE_FORMAT_SCORE) {
+            if (group.count == 1) {
+                std::printf("const Score %s = E(%d, %d);\n", group.name,
+                    (int) std::round(weights[group.start][0]), (int) std::round(weights[group.start][1]));
+                continue;
+            }
+            std::printf("const Score %s[%d] = {", group.name, group.count);
+            for (int i = 0; i < group.count; i++) {
+                if (i % 6 == 0)
+                    std::printf("\n   ");
+                std::printf(" E(%d, %d)%s", (int) std::round(weights[group.start + i][0]),
+                    (int) std::round(weights[group.start + i][1]), (i + 1 < group.count) ? "," : "");
+            }
+            std::printf("\n};\n");
+        } else {
+            int half = (group.format == TUNE_FORMAT_EG) ? 1 : 0;
+            if (group.count == 1) {
+                std::printf("const int %s = %d;\n", group.name, (int) std::round(weights[group.start][half]));
+                continue;
+            }
+            std::printf("const int %s[%d] = {", group.name, group.count);
+            printValues(weights, group.start, group.count, half, 8);
+            std::printf("\n};\n");
+        }
+    }
+}
+
+int runTune(int argc, char **argv) {
+    TuneOptions options;
+    if (!parseOptions(argc, argv, options))
+        return 1;
+
+    static int start[NUM_TUNE_TERMS][2];
+    static double weights[NUM_TUNE_TERMS][2];
+    int startMg[NUM_TUNE_TERMS], startEg[NUM_TUNE_TERMS];
+    getTuneWeights(startMg, startEg);
+    for (int term = 0; term < NUM_TUNE_TERMS; term++) {
+        start[term][0] = startMg[term];
+        start[term][1] = startEg[term];
+        weights[term][0] = startMg[term];
+        weights[term][1] = startEg[term];
+    }
+
+    ChessTime startTime = ChessClock::now();
+    std::vector<TuneShard *> shards;
+    for (int t = 0; t < options.threads; t++)
+        shards.push_back(new TuneShard());
+
+    uint64_t lines = loadPositions(options.input, shards, start);
+    uint64_t positions = 0, entries = 0;
+    for (TuneShard *shard : shards) {
+        positions += shard->positions.size();
+        entries += shard->entries.size();
+    }
+    std::printf("loaded %llu of %llu lines, %llu traced terms, %llu MB, time %llus\n",
+        (unsigned long long) positions, (unsigned long long) lines, (unsigned long long) entries,
+        (unsigned long long) ((positions * sizeof(TunePosition) + entries * sizeof(TuneEntry)) >> 20),
+        (unsigned long long) getTimeElapsed(startTime) / 1000);
+
+    if (positions) {
+        double k = fitK(shards, weights);
+        std::printf("K %.4f loss %.8f\n", k, runPass(shards, weights, k, nullptr));
+        if (options.coordinateDescent)
+            coordinateDescent(shards, weights, k, options, startTime);
+        else
+            gradientDescent(shards, weights, k, options, startTime);
+        printWeights(weights);
+    }
+
+    for (TuneShard *shard : shards)
+        delete shard;
+    return positions ? 0 : 1;
+}
+#endif
@@ -0,0 +1,18 @@
+#ifndef __TUNE_H__
+#define __TUNE_H__
+
+const int DEFAULT_TUNE_EPOCHS = 500;
+const double DEFAULT_TUNE_RATE = 1.0;
+
+// Texel tuning of the evaluation terms over a file of labelled positions,
+// one FEN or EPD per line with the game result from white's point of view
+// ("1-0", "0-1", "1/2-1/2", or [1.0], [0.5], [0.0]), or a file of packed
+// positions. Needs a build with make TUNE=1. Options:
+//   --input FILE     positions to tune on, packed if named *.packed
+//   --epochs N       gradient descent epochs
+//   --threads N      worker threads, all cores by default
+//   --rate X         Adam learning rate in centipawns
+//   --method gd|cd   gradient descent, or coordinate descent as a fallback
+int runTune(int argc, char **argv);
+
+#endif
@@ -0,0 +1,279 @@
+#include "uci.h"
+#include "search.h"
+#include "book.h"
+#include "nnue.h"
+#include "syzygy.h"
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+static Board board;
+static Searcher searcher;
+static std::thread searchThread;
+static std::vector<uint64_t> gameKeys;
+static bool ownBook = false;
+static bool bookBestMove = false;
+
+static void waitForSearch() {
+    searcher.stop();
+    if (searchThread.joinable())
+        searchThread.join();
+}
+
+Board fenToBoard(const std::string &fen) {
+    std::istringstream in(fen);
+    std::string placement, side, castling, ep;
+    int fiftyMoveCounter = 0, moveNumber = 1;
+    in >> placement >> side >> castling >> ep >> fiftyMoveCounter >> moveNumber;
+
+    int mailbox[64];
+    for (int sq = 0; sq < 64; sq++)
+        mailbox[sq] = -1;
+
+    const std::string pieceChars = "PNBRQKpnbrqk";
+    int rank = 7, file = 0;
+    for (char c : placement) {
+        if (c == '/') {
+            rank--;
+            file = 0;
+        } else if (c >= '1' && c <= '8') {
+            file += c - '0';
+        } else {
+            size_t piece = pieceChars.find(c);
+            if (piece != std::string::npos && rank >= 0 && file < 8)
+                mailbox[8 * rank + file] = (int) piece;
+            file++;
+        }
+    }
+
+    uint16_t epCaptureFile = NO_EP_POSSIBLE;
+    if (ep.size() == 2 && ep[0] >= 'a' && ep[0] <= 'h')
+        epCaptureFile = ep[0] - 'a';
+
+    return Board(mailbox,
+        castling.find('K') != std::string::npos,
+        castling.find('k') != std::string::npos,
+        castling.find('Q') != std::string::npos,
+        castling.find('q') != std::string::npos,
+        epCaptureFile, fiftyMoveCounter, moveNumber, side == "b" ? BLACK : WHITE);
+}
+
+std::string boardToFen(Board &b) {
+    const std::string pieceChars = "PNBRQKpnbrqk";
+    std::string fen;
+    for (int rank = 7; rank >= 0; rank--) {
+        int empty = 0;
+        for (int file = 0; file < 8; file++) {
+            int sq = 8 * rank + file;
+            int piece = -1;
+            for (int colour = WHITE; colour <= BLACK && piece < 0; colour++) {
+                piece = b.getPieceOnSquare(colour, sq);
+                if (piece >= 0)
+                    piece += 6 * colour;
+            }
+            if (piece < 0) {
+                empty++;
+                continue;
+            }
+            if (empty)
+                fen += (char) ('0' + empty);
+            empty = 0;
+            fen += pieceChars[piece];
+        }
+        if (empty)
+            fen += (char) ('0' + empty);
+        if (rank)
+            fen += '/';
+    }
+
+    int colour = b.getPlayerToMove();
+    fen += (colour == WHITE) ? " w " : " b ";
+    int castling = b.getCastlingRights();
+    if (castling & WHITEKSIDE) fen += 'K';
+    if (castling & WHITEQSIDE) fen += 'Q';
+    if (castling & BLACKKSIDE) fen += 'k';
+    if (castling & BLACKQSIDE) fen += 'q';
+    if (!castling)
+        fen += '-';
+
+    if (b.getEPCaptureFile() == NO_EP_POSSIBLE) {
+        fen += " -";
+    } else {
+        fen += ' ';
+        fen += (char) ('a' + b.getEPCaptureFile());
+        fen += (colour == WHITE) ? '6' : '3';
+    }
+    return fen + " " + std::to_string(b.getFiftyMoveCounter()) + " "
+         + std::to_string(b.getMoveNumber());
+}
+
+Move stringToMove(Board &b, const std::string &moveStr) {
+    ScoredMove buffer[MAX_MOVES];
+    ScoredMoveList legalMoves(buffer);
+    b.getAllLegalMove(legalMoves, b.getPlayerToMove());
+    for (unsigned int i = 0; i < legalMoves.size(); i++) {
+        if (moveToString(legalMoves.get(i)) == moveStr)
+            return legalMoves.get(i);
+    }
+    return NULL_MOVE;
+}
+
+static void setPosition(std::istringstream &in) {
+    std::string token, fen;
+    in >> token;
+    if (token == "startpos") {
+        fen = STARTPOS;
+        in >> token;
+    } else if (token == "fen") {
+        while (in >> token && token != "moves")
+            fen += token + " ";
+    } else {
+        return;
+    }
+
+    board = fenToBoard(fen);
+    gameKeys.clear();
+    if (token != "moves")
+        return;
+    while (in >> token) {
+        Move m = stringToMove(board, token);
+        if (m == NULL_MOVE)
+            break;
+        gameKeys.push_back(board.getZobristKey());
+        board.doMove(m, board.getPlayerToMove());
+    }
+}
+
+static void go(std::istringstream &in) {
+    SearchLimits limits;
+    std::string token;
+    while (in >> token) {
+        if (token == "wtime") in >> limits.time[WHITE];
+        else if (token == "btime") in >> limits.time[BLACK];
+        else if (token == "winc") in >> limits.inc[WHITE];
+        else if (token == "binc") in >> limits.inc[BLACK];
+        else if (token == "movestogo") in >> limits.movesToGo;
+        else if (token == "movetime") in >> limits.moveTime;
+        else if (token == "depth") in >> limits.depth;
+        else if (token == "nodes") in >> limits.nodes;
+        else if (token == "infinite") limits.infinite = true;
+    }
+
+    waitForSearch();
+    if (ownBook && !limits.infinite) {
+        Move bookMove = probeBook(board, bookBestMove);
+        if (bookMove != NULL_MOVE) {
+            std::cout << "bestmove " << moveToString(bookMove) << std::endl;
+            return;
+        }
+    }
+
+    searcher.clearStop();
+    searcher.setGameHistory(gameKeys);
+    Board rootBoard = board.staticCopy();
+    searchThread = std::thread([rootBoard, limits]() mutable {
+        Move bestMove = searcher.getBestMove(rootBoard, limits);
+        // UCI forbids sending bestmove before stop during infinite analysis
+        while (limits.infinite && !searcher.isStopRequested())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        std::cout << "bestmove " << moveToString(bestMove) << std::endl;
+    });
+}
+
+// Spin values which are empty or not a number are ignored
+static bool parseSpin(const std::string &value, int &spin) {
+    std::istringstream in(value);
+    return (bool) (in >> spin);
+}
+
+static void setOption(std::istringstream &in) {
+    std::string token, name, value;
+    in >> token;
+    while (in >> token && token != "value")
+        name += (name.empty() ? "" : " ") + token;
+    // Paths may contain spaces, so the value is the rest of the line
+    std::getline(in >> std::ws, value);
+
+    int spin;
+    if (name == "Move Overhead") {
+        if (parseSpin(value, spin))
+            TimeManager::setMoveOverhead(spin);
+    } else if (name == "SyzygyPath")
+        initTablebases(value);
+    else if (name == "SyzygyProbeLimit") {
+        if (parseSpin(value, spin))
+            setTablebaseProbeLimit(spin);
+    } else if (name == "EvalFile") {
+        loadNetwork(value);
+        searcher.clearCaches();
+    } else if (name == "Use NNUE") {
+        setUseNNUE(value == "true");
+        searcher.clearCaches();
+    } else if (name == "OwnBook")
+        ownBook = (value == "true");
+    else if (name == "BookFile")
+        openBook(value);
+    else if (name == "BookBestMove")
+        bookBestMove = (value == "true");
+    else if (name == "MultiPV") {
+        if (parseSpin(value, spin))
+            searcher.setMultiPV(spin);
+    }
+}
+
+void uciLoop() {
+    board = fenToBoard(STARTPOS);
+    std::string line;
+
+    while (std::getline(std::cin, line)) {
+        std::istringstream in(line);
+        std::string command;
+        in >> command;
+
+        if (command == "uci") {
+            std::cout << "id name Brahma" << std::endl;
+            std::cout << "id author kkmonlee" << std::endl;
+            std::cout << "option name Move Overhead type spin default "
+                      << DEFAULT_MOVE_OVERHEAD << " min 0 max " << MAX_MOVE_OVERHEAD << std::endl;
+            std::cout << "option name SyzygyPath type string default <empty>" << std::endl;
+            std::cout << "option name EvalFile type string default <empty>" << std::endl;
+            std::cout << "option name Use NNUE type check default true" << std::endl;
+            std::cout << "option name SyzygyProbeLimit type spin default "
+                      << TB_MAX_PIECES << " min 0 max " << TB_MAX_PIECES << std::endl;
+            std::cout << "option name OwnBook type check default false" << std::endl;
+            std::cout << "option name BookFile type string default <empty>" << std::endl;
+            std::cout << "option name BookBestMove type check default false" << std::endl;
+            std::cout << "option name MultiPV type spin default 1 min 1 max " << MAX_MULTI_PV << std::endl;
+            std::cout << "uciok" << std::endl;
+        } else if (command == "isready") {
+            std::cout << "readyok" << std::endl;
+        } else if (command == "ucinewgame") {
+            waitForSearch();
+            searcher.clearCaches();
+            searcher.clearStats();
+            board = fenToBoard(STARTPOS);
+            gameKeys.clear();
+        } else if (command == "position") {
+            waitForSearch();
+            setPosition(in);
+        } else if (command == "go") {
+            go(in);
+        } else if (command == "stop") {
+            waitForSearch();
+        } else if (command == "setoption") {
+            waitForSearch();
+            setOption(in);
+        } else if (command == "cachestats") {
+            waitForSearch();
+            searcher.printCacheStats();
+        } else if (command == "stats") {
+            // Accumulated over every search since the last ucinewgame
+            waitForSearch();
+            searcher.getStats().print();
+        } else if (command == "quit") {
+            break;
+        }
+    }
+
+    waitForSearch();
+}
@@ -0,0 +1,14 @@
+#ifndef __UCI_H__
+#define __UCI_H__
+
+#include "board.h"
+#include <string>
+
+const std::string STARTPOS = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+Board fenToBoard(const std::string &fen);
+std::string boardToFen(Board &b);
+Move stringToMove(Board &b, const std::string &moveStr);
+void uciLoop();
+
+#endif